@@ -0,0 +1,80 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief Number of timed samples per benchmark.
+ */
+#define BENCH_SAMPLES 1000
+
+/**
+ * @brief Untimed iterations run before each benchmark to warm up caches and TLBs.
+ */
+#define BENCH_WARMUP 50
+
+/**
+ * @brief Number of sectors at the start of the disk the random read benchmark picks from.
+ *
+ * Stays within the smallest disk image `tar` writes (20 sectors).
+ */
+#define BENCH_DISK_SECTORS 16
+
+/**
+ * @brief Disks of the sequential read benchmark, as `diskread()` handles.
+ *
+ * With two scratch disks (`make bench-stripe`), handle 1 is the first scratch
+ * disk and handle 3 the stripe over both. Without scratch disks the benchmark
+ * is skipped: the handles then name the RAM disk or nothing.
+ */
+#define BENCH_SCRATCH_DEV 1
+#define BENCH_STRIPE_DEV 3
+
+/**
+ * @brief Sectors read per sample of the sequential read benchmark (64 KiB, the `diskread()` maximum).
+ */
+#define BENCH_SEQ_SECTORS 128
+
+/**
+ * @brief Number of sectors at the start of a scratch disk the sequential read benchmark cycles through (8 MiB).
+ */
+#define BENCH_SEQ_SPAN 16384
+
+/**
+ * @brief `getarg()` value of the partner process of the context switch benchmark.
+ */
+#define BENCH_PARTNER 1
+
+/**
+ * @brief Entry point of the benchmark suite.
+ *
+ * Measures the cost of the kernel's hot paths with the `cycle` counter:
+ *
+ * - `null_syscall`     : `SYS_NULL` round trip (trap entry and exit).
+ * - `putchar`          : One character to the console.
+ * - `readfile_<n>`     : Reading `n` bytes of a file, for several sizes.
+ * - `writefile_<n>`    : Writing `n` bytes of a file, for several sizes.
+ * - `ctxswitch_pingpong`: `sched_yield()` to a partner process that yields
+ *                        straight back, i.e. two context switches.
+ * - `disk_randread_<n>`: Reading `n` bytes at a random sector of the primary raw
+ *                        block device (`diskread()`), i.e. one device round trip.
+ *                        Compare runs with `make bench-virtq`.
+ * - `disk_seqread_{single,stripe}_<n>`: Reading `n` bytes sequentially from a
+ *                        scratch disk, and from the stripe over two scratch
+ *                        disks. Only with scratch disks; see `make bench-stripe`.
+ *
+ * Every benchmark prints one machine-parseable CSV line prefixed with `BENCH,`:
+ *
+ * @code
+ * BENCH,name,samples,min,median,p99
+ * BENCH,null_syscall,1000,312,330,402
+ * @endcode
+ *
+ * All values are cycles per operation. The suite ends with a `BENCH,done`
+ * line. The file benchmarks use "meow.txt" and restore its contents afterwards.
+ *
+ * Started at boot (`init=bench` kernel argument, see `make bench`) instead of
+ * from the shell, it shuts the machine down when done.
+ *
+ * Spawned with `BENCH_PARTNER` as argument, the program instead acts as the
+ * partner of the context switch benchmark.
+ */
+void main(void);
@@ -0,0 +1,246 @@
+#include "bench.h"
+
+#include "ecall.h"
+#include "lib.h"
+#include "types.h"
+#include "utils.h"
+#include "vsyscall.h"
+
+/**
+ * @brief Timed samples of the running benchmark, in cycles.
+ */
+uint32_t samples[BENCH_SAMPLES];
+
+/**
+ * @brief Reads the `cycle` counter.
+ */
+uint32_t read_cycles(void) {
+    uint32_t cycles;
+    __asm__ __volatile__("rdcycle %0" : "=r"(cycles));
+    return cycles;
+}
+
+/**
+ * @brief Sorts the samples in ascending order (insertion sort).
+ *
+ * @param n Number of samples.
+ */
+void sort_samples(size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        uint32_t v = samples[i];
+        size_t j = i;
+        for (; j > 0 && samples[j - 1] > v; j--)
+            samples[j] = samples[j - 1];
+        samples[j] = v;
+    }
+}
+
+/**
+ * @brief Prints the result line of a benchmark.
+ *
+ * @param name Name of the benchmark.
+ * @param size Transfer size appended to the name as `_<size>`, or 0 for none.
+ * @param n    Number of samples.
+ */
+void report(const char *name, size_t size, size_t n) {
+    sort_samples(n);
+    if (size)
+        printf("BENCH,%s_%d,", name, size);
+    else
+        printf("BENCH,%s,", name);
+    printf("%d,%d,%d,%d\n", n, samples[0], samples[n / 2], samples[n * 99 / 100]);
+}
+
+/**
+ * @brief Benchmarks the system call round trip with `SYS_NULL`.
+ */
+void bench_null_syscall(void) {
+    for (size_t i = 0; i < BENCH_WARMUP; i++)
+        syscall_null();
+
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        uint32_t start = read_cycles();
+        syscall_null();
+        samples[i] = read_cycles() - start;
+    }
+    report("null_syscall", 0, BENCH_SAMPLES);
+}
+
+/**
+ * @brief Benchmarks console output of a single character.
+ */
+void bench_putchar(void) {
+    // Every sample prints a character, so keep the line short.
+    const size_t n = 100;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t start = read_cycles();
+        putchar('.');
+        samples[i] = read_cycles() - start;
+    }
+    putchar('\n');
+    report("putchar", 0, n);
+}
+
+/**
+ * @brief Benchmarks reading or writing a file.
+ *
+ * @param filename Name of the file.
+ * @param len      Bytes per operation.
+ * @param is_write True to benchmark `writefile()`, false for `readfile()`.
+ */
+void bench_file(const char *filename, size_t len, bool is_write) {
+    char buf[1024];
+
+    memset(buf, 'x', sizeof(buf));
+    for (size_t i = 0; i < BENCH_WARMUP + BENCH_SAMPLES; i++) {
+        uint32_t start = read_cycles();
+        if (is_write)
+            writefile(filename, buf, len);
+        else
+            readfile(filename, buf, len);
+        if (i >= BENCH_WARMUP)
+            samples[i - BENCH_WARMUP] = read_cycles() - start;
+    }
+
+    report(is_write ? "writefile" : "readfile", len, BENCH_SAMPLES);
+}
+
+/**
+ * @brief Runs the file benchmarks for all sizes.
+ */
+void bench_files(void) {
+    const char *filename = "meow.txt";
+    const size_t sizes[] = {16, 128, 1024};
+
+    // The write benchmarks overwrite the file; put it back afterwards.
+    char saved[1024];
+    int32_t saved_len = readfile(filename, saved, sizeof(saved));
+    if (saved_len < 0) {
+        FAILED("cannot read %s: %d", filename, saved_len);
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        bench_file(filename, sizes[i], false);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        bench_file(filename, sizes[i], true);
+
+    writefile(filename, saved, saved_len);
+}
+
+/**
+ * @brief Benchmarks a context switch round trip between two processes.
+ */
+void bench_ctxswitch(void) {
+    int32_t partner = spawn("bench", BENCH_PARTNER);
+    if (partner < 0) {
+        FAILED("cannot spawn the partner process: %d", partner);
+        return;
+    }
+
+    // Each yield runs the partner, which yields straight back.
+    for (size_t i = 0; i < BENCH_WARMUP; i++)
+        sched_yield();
+
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        uint32_t start = read_cycles();
+        sched_yield();
+        samples[i] = read_cycles() - start;
+    }
+
+    wait(partner);
+    report("ctxswitch_pingpong", 0, BENCH_SAMPLES);
+}
+
+/**
+ * @brief Benchmarks small reads at random sectors of the raw block device.
+ *
+ * @param len Bytes per read, a multiple of 512.
+ */
+void bench_disk(size_t len) {
+    static char buf[4096];
+    uint32_t sectors = len / 512, seed = 2463534242u;
+
+    for (size_t i = 0; i < BENCH_WARMUP + BENCH_SAMPLES; i++) {
+        // xorshift32: cheap, and the same sequence on every run.
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        uint32_t sector = seed % (BENCH_DISK_SECTORS - sectors + 1);
+
+        uint32_t start = read_cycles();
+        int32_t ret = diskread(0, sector, buf, sectors);
+        if (i >= BENCH_WARMUP)
+            samples[i - BENCH_WARMUP] = read_cycles() - start;
+        if (ret < 0) {
+            FAILED("diskread failed: %d", ret);
+            return;
+        }
+    }
+
+    report("disk_randread", len, BENCH_SAMPLES);
+}
+
+/**
+ * @brief Benchmarks sequential reads of `BENCH_SEQ_SECTORS` from a raw disk.
+ *
+ * @param name Name of the benchmark.
+ * @param dev  `diskread()` handle of the disk; skipped if there is no such disk
+ *             or it is smaller than `BENCH_SEQ_SPAN` (such as the RAM disk).
+ */
+void bench_disk_seq(const char *name, uint32_t dev) {
+    static char buf[BENCH_SEQ_SECTORS * 512];
+    uint32_t sector = 0;
+
+    if (diskread(dev, BENCH_SEQ_SPAN - BENCH_SEQ_SECTORS, buf, BENCH_SEQ_SECTORS) < 0)
+        return;
+
+    for (size_t i = 0; i < BENCH_WARMUP + BENCH_SAMPLES; i++) {
+        uint32_t start = read_cycles();
+        int32_t ret = diskread(dev, sector, buf, BENCH_SEQ_SECTORS);
+        if (i >= BENCH_WARMUP)
+            samples[i - BENCH_WARMUP] = read_cycles() - start;
+        if (ret < 0) {
+            FAILED("diskread failed: %d", ret);
+            return;
+        }
+        sector = (sector + BENCH_SEQ_SECTORS) % BENCH_SEQ_SPAN;
+    }
+
+    report(name, sizeof(buf), BENCH_SAMPLES);
+}
+
+/**
+ * @brief Partner of `bench_ctxswitch()`: yields back as often as it is yielded to.
+ *
+ * Yields a few more times than needed, so that the measuring process never
+ * finds it gone early; the surplus yields return immediately once the
+ * measuring process waits.
+ */
+void partner_main(void) {
+    for (size_t i = 0; i < BENCH_WARMUP + BENCH_SAMPLES + BENCH_WARMUP; i++)
+        sched_yield();
+}
+
+void main(void) {
+    if (getarg() == BENCH_PARTNER) {
+        partner_main();
+        return;
+    }
+
+    printf("BENCH,name,samples,min,median,p99\n");
+    bench_null_syscall();
+    bench_putchar();
+    bench_files();
+    bench_ctxswitch();
+    bench_disk(512);
+    bench_disk(4096);
+    bench_disk_seq("disk_seqread_single", BENCH_SCRATCH_DEV);
+    bench_disk_seq("disk_seqread_stripe", BENCH_STRIPE_DEV);
+    printf("BENCH,done\n");
+
+    // Started by the kernel (init=bench) rather than from the shell: this is a
+    // headless run, so power off once the results are out.
+    if (getppid() == 0)
+        shutdown();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+/**
+ * @brief Error numbers returned by system calls.
+ *
+ * A system call that fails returns the negated error number (e.g. `-ENOENT`),
+ * so any negative return value is an error and non-negative values are results.
+ * The values match the ones used by Linux.
+ */
+#define EPERM 1        ///< Operation not permitted.
+#define ENOENT 2       ///< No such file.
+#define EINTR 4        ///< Interrupted.
+#define EIO 5          ///< Input/output error.
+#define EBADF 9        ///< Bad file or descriptor.
+#define ECHILD 10      ///< No such child process.
+#define EAGAIN 11      ///< Resource temporarily unavailable; try again.
+#define ENOMEM 12      ///< Out of memory.
+#define EFAULT 14      ///< Bad address.
+#define EBUSY 16       ///< Device or resource busy.
+#define ENODEV 19      ///< No such device.
+#define EINVAL 22      ///< Invalid argument.
+#define ENOSPC 28      ///< No space left.
+#define ENOSYS 38      ///< No such system call.
+#define ETIMEDOUT 110  ///< Timed out.
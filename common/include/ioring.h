@@ -0,0 +1,97 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief Shared submission/completion rings for batched system calls.
+ *
+ * A process can ask the kernel for one page that is mapped into both its
+ * address space and the kernel's (`SYS_RING_SETUP`). The page holds two
+ * single-producer/single-consumer rings:
+ *
+ * - The submission queue (SQ): the process fills `struct ring_sqe` entries and
+ *   advances `sq_tail`; the kernel consumes them and advances `sq_head`.
+ * - The completion queue (CQ): the kernel posts one `struct ring_cqe` per
+ *   finished operation and advances `cq_tail`; the process consumes them and
+ *   advances `cq_head`.
+ *
+ * A single `SYS_RING_ENTER` then executes any number of queued operations, so
+ * an I/O-heavy program pays for one trap instead of one per operation. The
+ * layout is part of the system call ABI and must be identical on both sides.
+ */
+
+/**
+ * @brief User virtual address the ring page is mapped at.
+ *
+ * Right above the user image, which the user linker script keeps below it.
+ */
+#define RING_VADDR 0x1800000
+
+/**
+ * @brief Number of entries of each ring. Must be a power of two.
+ *
+ * Head and tail indices run freely and are reduced with `RING_MASK`, so the
+ * number of queued entries is always `tail - head`.
+ */
+#define RING_ENTRIES 128
+#define RING_MASK (RING_ENTRIES - 1)
+
+/**
+ * @brief Operations of `ring_sqe::opcode`.
+ *
+ * - `RING_OP_NOP`:       Completes immediately with 0.
+ * - `RING_OP_READ`:      Reads `len` characters from the console into `addr`.
+ * - `RING_OP_WRITE`:     Writes `len` characters at `addr` to the console.
+ * - `RING_OP_READFILE`:  Like `SYS_READFILE`: file `name`, buffer `addr`, length `len`.
+ * - `RING_OP_WRITEFILE`: Like `SYS_WRITEFILE`: file `name`, buffer `addr`, length `len`.
+ * - `RING_OP_TIMEOUT`:   Completes with 0 once the time in nanoseconds at `addr`
+ *                        (a `uint64_t`) has passed; relative unless `flags`
+ *                        contains `TIMER_ABSTIME`. Does not block the submitter.
+ */
+#define RING_OP_NOP 0
+#define RING_OP_READ 1
+#define RING_OP_WRITE 2
+#define RING_OP_READFILE 3
+#define RING_OP_WRITEFILE 4
+#define RING_OP_TIMEOUT 5
+
+/**
+ * @brief Maximum number of `RING_OP_TIMEOUT` operations in flight per process.
+ */
+#define RING_TIMEOUTS_MAX 8
+
+/**
+ * @struct ring_sqe
+ * @brief A submission queue entry: one operation.
+ */
+struct ring_sqe {
+    uint8_t opcode;      ///< One of `RING_OP_*`.
+    uint8_t flags;       ///< Operation-specific flags.
+    uint16_t reserved;   ///< Must be 0.
+    uint32_t user_data;  ///< Copied unchanged into the completion.
+    uint32_t addr;       ///< Buffer address.
+    uint32_t len;        ///< Buffer length in bytes.
+    uint32_t name;       ///< File name address (file operations only).
+};
+
+/**
+ * @struct ring_cqe
+ * @brief A completion queue entry: the result of one operation.
+ */
+struct ring_cqe {
+    uint32_t user_data;  ///< `user_data` of the submission.
+    int32_t res;         ///< Result like the equivalent system call's (negated error number on failure).
+};
+
+/**
+ * @struct ioring
+ * @brief Layout of the shared ring page.
+ */
+struct ioring {
+    volatile uint32_t sq_head;      ///< Next entry the kernel consumes (written by the kernel).
+    volatile uint32_t sq_tail;      ///< Next entry the process fills (written by the process).
+    volatile uint32_t cq_head;      ///< Next completion the process consumes (written by the process).
+    volatile uint32_t cq_tail;      ///< Next completion the kernel posts (written by the kernel).
+    uint32_t reserved[4];           ///< Pads the indices to 32 bytes.
+    struct ring_sqe sqes[RING_ENTRIES];  ///< Submission queue.
+    struct ring_cqe cqes[RING_ENTRIES];  ///< Completion queue.
+};
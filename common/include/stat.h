@@ -0,0 +1,98 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief Statistics structures shared between the kernel and user programs.
+ *
+ * The kernel fills these structures in response to the statistics system calls,
+ * and user programs (e.g. the shell) read and render them. Their layout is part
+ * of the system call ABI and must be identical on both sides.
+ */
+
+/**
+ * @struct pagestat
+ * @brief Counters of one hart's page cache (see `alloc_pages()`).
+ *
+ * The hit rate of a hart is `hits * 100 / allocs`: the percentage of single-page
+ * allocations that were served from the hart-local cache without touching the
+ * global page pool.
+ */
+struct pagestat {
+    uint32_t allocs;   ///< Single-page allocations requested on this hart.
+    uint32_t hits;     ///< Allocations served directly from the hart-local cache.
+    uint32_t frees;    ///< Single pages freed into the hart-local cache.
+    uint32_t refills;  ///< Batches pulled from the global pool into the cache.
+    uint32_t drains;   ///< Batches pushed back from the cache to the global pool.
+    uint32_t cached;   ///< Pages currently held in the cache.
+};
+
+/**
+ * @brief Values of `procstat::state`.
+ *
+ * These mirror the kernel's `PROC_*` process states.
+ */
+#define PROCSTAT_RUNNABLE 1  ///< Running or ready to run.
+#define PROCSTAT_EXITED 2    ///< Exited, waiting to be reaped.
+#define PROCSTAT_BLOCKED 3   ///< Sleeping on a wait queue or timer.
+
+/**
+ * @struct procstat
+ * @brief Scheduler statistics of one process or kernel thread.
+ *
+ * Times are charged from the `time` CSR at every trap entry and exit and at
+ * every context switch, and reported in nanoseconds. The CPU share of a process
+ * over an interval is the growth of `utime + stime` divided by the interval.
+ */
+struct procstat {
+    int32_t pid;       ///< Process ID (0 is the idle process).
+    int32_t state;     ///< One of the `PROCSTAT_*` values.
+    bool kernel;       ///< True for kernel threads (and the idle process).
+    uint64_t utime;    ///< Time spent running in user mode, in nanoseconds.
+    uint64_t stime;    ///< Time spent running in the kernel, in nanoseconds.
+    uint32_t nvcsw;    ///< Voluntary context switches (blocked or yielded).
+    uint32_t nivcsw;   ///< Involuntary context switches (preempted at the end of a time slice).
+};
+
+/** Maximum length of `iostat::name`, including the terminating NUL */
+#define IOSTAT_NAME_MAX 12
+
+/**
+ * @brief Operation types of `iostat`, as indices of its per-operation arrays.
+ */
+#define IOSTAT_READ 0   ///< Reads.
+#define IOSTAT_WRITE 1  ///< Writes.
+#define IOSTAT_FLUSH 2  ///< Flushes of the write cache.
+#define IOSTAT_OPS 3    ///< Number of operation types.
+
+/**
+ * @brief Number of buckets of an `iostat` latency histogram.
+ *
+ * Bucket 0 counts operations that took less than 1 us, bucket `b` those that
+ * took `2^(b-1)` to `2^b - 1` us, and the last bucket everything longer.
+ */
+#define IOSTAT_BUCKETS 24
+
+/**
+ * @struct iostat
+ * @brief I/O statistics of one block device since boot.
+ *
+ * Operations are counted where the kernel's block layer hands them to the
+ * device's backend, so their latencies include the time requests wait in the
+ * driver; a stripe's pieces count as operations of its member disks too. The
+ * depth (`inflight`) and `busy` count the requests the backend has issued to
+ * the device, so one large operation split into several requests counts
+ * several times. The utilization of the device over an interval is the growth
+ * of `busy` divided by the interval.
+ */
+struct iostat {
+    char name[IOSTAT_NAME_MAX];  ///< Name of the device, e.g. "virtio0".
+    uint32_t capacity;           ///< Capacity in sectors.
+    uint32_t ops[IOSTAT_OPS];      ///< Completed operations, by type.
+    uint32_t sectors[IOSTAT_OPS];  ///< Sectors transferred, by type (0 for flushes).
+    uint32_t errors;               ///< Operations that failed.
+    uint32_t inflight;             ///< Requests in flight right now.
+    uint32_t inflight_max;         ///< Most requests ever in flight at once.
+    uint64_t busy;                 ///< Time with at least one request in flight, in nanoseconds.
+    uint64_t latency[IOSTAT_OPS];  ///< Time the operations took, summed up by type, in nanoseconds.
+    uint32_t histogram[IOSTAT_OPS][IOSTAT_BUCKETS];  ///< Latencies by type, see `IOSTAT_BUCKETS`.
+};
@@ -11,6 +11,10 @@
  * - The `SYS_*` macros define unique identifiers for different system calls
  *   supported by the operating system. These identifiers are used by user programs
  *   to request services from the kernel.
+ *
+ * System calls follow the standard RISC-V convention: the number is passed in
+ * `a7`, up to six arguments in `a0`-`a5`, and the result is returned in `a0`.
+ * Failures are reported as a negated error number (see `errno.h`).
  */
 #define SCAUSE_ECALL 8
 
@@ -26,3 +30,52 @@
 #define SYS_READFILE 4   ///< Read data from a file.
 #define SYS_WRITEFILE 5  ///< Write data to a file.
 #define SYS_SHUTDOWN 8   ///< Shutdown the system.
+#define SYS_PAGESTAT 9   ///< Read the per-hart page cache statistics.
+#define SYS_NANOSLEEP 10      ///< Sleep for a duration or until an absolute time.
+#define SYS_CLOCK_GETTIME 11  ///< Read the monotonic clock in nanoseconds.
+#define SYS_PROCSTAT 12       ///< Read the scheduler statistics of all processes.
+#define SYS_NULL 13           ///< Do nothing; measures the system call round trip.
+#define SYS_RING_SETUP 14     ///< Map the shared submission/completion rings (see `ioring.h`).
+#define SYS_RING_ENTER 15     ///< Execute queued submissions and wait for completions.
+#define SYS_SPAWN 16          ///< Start an embedded user program as a child process.
+#define SYS_WAIT 17           ///< Wait for a child process to exit.
+#define SYS_SCHED_YIELD 18    ///< Give up the CPU to another runnable process.
+#define SYS_DISKREAD 19       ///< Read raw sectors of a block device.
+#define SYS_IOSTAT 20         ///< Get I/O statistics of every block device.
+
+/**
+ * @brief The system call table.
+ *
+ * Lists every system call once as `X(number, name, number of arguments)`. The
+ * kernel expands it into its dispatch table (handler `sys_<name>`), and user
+ * programs into their raw stubs (`syscall_<name>`), so the two sides cannot
+ * drift apart. Adding a system call means adding a line here, a handler in the
+ * kernel and, if wanted, a typed wrapper in user space.
+ */
+#define SYSCALLS(X)                        \
+    X(SYS_PUTCHAR, putchar, 1)             \
+    X(SYS_GETCHAR, getchar, 1)             \
+    X(SYS_EXIT, exit, 0)                   \
+    X(SYS_READFILE, readfile, 3)           \
+    X(SYS_WRITEFILE, writefile, 3)         \
+    X(SYS_SHUTDOWN, shutdown, 0)           \
+    X(SYS_PAGESTAT, pagestat, 2)           \
+    X(SYS_NANOSLEEP, nanosleep, 3)         \
+    X(SYS_CLOCK_GETTIME, clock_gettime, 1) \
+    X(SYS_PROCSTAT, procstat, 2)           \
+    X(SYS_NULL, null, 0)                   \
+    X(SYS_RING_SETUP, ring_setup, 0)       \
+    X(SYS_RING_ENTER, ring_enter, 2)       \
+    X(SYS_SPAWN, spawn, 2)                 \
+    X(SYS_WAIT, wait, 1)                   \
+    X(SYS_SCHED_YIELD, sched_yield, 0)     \
+    X(SYS_DISKREAD, diskread, 4)           \
+    X(SYS_IOSTAT, iostat, 2)
+
+/**
+ * @brief Flag for `SYS_NANOSLEEP`: the time is an absolute `SYS_CLOCK_GETTIME`
+ * value rather than a duration.
+ *
+ * Sleeping until an absolute deadline lets periodic loops avoid accumulating drift.
+ */
+#define TIMER_ABSTIME 1
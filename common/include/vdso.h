@@ -0,0 +1,62 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief Kernel data pages mapped read-only into every user process.
+ *
+ * Some information is cheap for the kernel to publish but expensive to ask
+ * for with a system call. The kernel therefore maps two pages into every
+ * process, which user code reads with plain loads:
+ *
+ * - `VDSO_VADDR`: one page shared by all processes (`struct vdso_data`) with
+ *   the time base and system-wide counters.
+ * - `VDSO_PROC_VADDR`: one page per process (`struct vdso_proc`) with its
+ *   identifiers.
+ *
+ * Together with user access to the `time` CSR this makes reading the clock or
+ * the own pid a load instead of a trap. The layout is part of the system call
+ * ABI and must be identical on both sides.
+ */
+
+/**
+ * @brief User virtual addresses of the shared and the per-process page.
+ *
+ * Right above the page reserved for the submission/completion rings (`RING_VADDR`).
+ */
+#define VDSO_VADDR 0x1801000
+#define VDSO_PROC_VADDR 0x1802000
+
+/**
+ * @struct vdso_counters
+ * @brief System-wide event counters, protected by `vdso_data::seq`.
+ */
+struct vdso_counters {
+    uint64_t context_switches;  ///< Process switches since boot.
+    uint64_t syscalls;          ///< System calls since boot.
+    uint64_t interrupts;        ///< Interrupts handled since boot.
+};
+
+/**
+ * @struct vdso_data
+ * @brief Layout of the page shared by all processes.
+ *
+ * `counters` is updated under a sequence lock: the kernel makes `seq` odd
+ * before and even again after each update. A reader copies `counters` and
+ * retries if `seq` was odd or changed meanwhile, so it never sees a torn
+ * 64-bit value and never blocks the kernel.
+ */
+struct vdso_data {
+    volatile uint32_t seq;          ///< Sequence count of `counters`.
+    uint32_t timebase_freq;         ///< Frequency of the `time` CSR in ticks per second.
+    struct vdso_counters counters;  ///< System-wide counters.
+};
+
+/**
+ * @struct vdso_proc
+ * @brief Layout of the per-process page.
+ */
+struct vdso_proc {
+    int32_t pid;   ///< Process ID of the owning process.
+    int32_t ppid;  ///< Process ID of the process that spawned it, or 0.
+    int32_t arg;   ///< Argument the process was spawned with (see `SYS_SPAWN`), or 0.
+};
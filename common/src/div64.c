@@ -0,0 +1,66 @@
+#include "lib.h"
+#include "types.h"
+
+// RV32 has no 64-bit divide instruction, so the compiler lowers 64-bit `/` and
+// `%` to calls into its runtime library (libgcc / compiler-rt). We link with
+// -nostdlib, so the helpers it expects are provided here.
+
+/**
+ * @brief Divides two unsigned 64-bit integers.
+ *
+ * Uses restoring (shift-subtract) division, one quotient bit per iteration,
+ * with a fast path through the native 32-bit divider when both operands fit.
+ *
+ * @param num Dividend.
+ * @param den Divisor.
+ * @param rem If not NULL, receives the remainder.
+ * @return The quotient. Division by zero returns all ones, like `divu`.
+ */
+uint64_t __udivmoddi4(uint64_t num, uint64_t den, uint64_t *rem) {
+    uint64_t quot = 0;
+    uint64_t r = 0;
+
+    if (den == 0) {
+        if (rem) *rem = num;
+        return (uint64_t)-1;
+    }
+
+    if ((num >> 32) == 0 && (den >> 32) == 0) {
+        if (rem) *rem = (uint32_t)num % (uint32_t)den;
+        return (uint32_t)num / (uint32_t)den;
+    }
+
+    for (int32_t i = 63; i >= 0; i--) {
+        r = (r << 1) | ((num >> i) & 1);
+        if (r >= den) {
+            r -= den;
+            quot |= (uint64_t)1 << i;
+        }
+    }
+
+    if (rem) *rem = r;
+    return quot;
+}
+
+uint64_t __udivdi3(uint64_t num, uint64_t den) {
+    return __udivmoddi4(num, den, NULL);
+}
+
+uint64_t __umoddi3(uint64_t num, uint64_t den) {
+    uint64_t rem;
+    __udivmoddi4(num, den, &rem);
+    return rem;
+}
+
+int64_t __divdi3(int64_t num, int64_t den) {
+    bool negative = (num < 0) != (den < 0);
+    uint64_t quot = __udivdi3(num < 0 ? -(uint64_t)num : (uint64_t)num,
+                              den < 0 ? -(uint64_t)den : (uint64_t)den);
+    return negative ? -(int64_t)quot : (int64_t)quot;
+}
+
+int64_t __moddi3(int64_t num, int64_t den) {
+    uint64_t rem = __umoddi3(num < 0 ? -(uint64_t)num : (uint64_t)num,
+                             den < 0 ? -(uint64_t)den : (uint64_t)den);
+    return num < 0 ? -(int64_t)rem : (int64_t)rem;
+}
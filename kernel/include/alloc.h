@@ -1,20 +1,56 @@
 #pragma once
+#include "riscv.h"
+#include "stat.h"
 #include "types.h"
 
+/**
+ * @brief Per-hart page cache (magazine) sizing.
+ *
+ * Every hart keeps a small stack of free pages in front of the global page pool.
+ * Single-page allocations and frees only touch the hart-local cache, so the
+ * common path takes no lock and writes no cache line shared with other harts.
+ *
+ * - `PAGE_CACHE_SIZE`: Capacity of a hart-local cache in pages.
+ * - `PAGE_CACHE_LOW`:  Low watermark. An allocation that finds the cache empty
+ *                      refills it from the global pool up to this many pages.
+ * - `PAGE_CACHE_HIGH`: High watermark. A free that pushes the cache above this
+ *                      many pages drains it back to the global pool down to
+ *                      `PAGE_CACHE_LOW` pages.
+ *
+ * Moving pages in batches amortizes the global lock over many allocations, and
+ * the gap between the watermarks keeps a hart that alternates between
+ * allocating and freeing from bouncing pages back and forth.
+ */
+#define PAGE_CACHE_SIZE 64
+#define PAGE_CACHE_LOW 16
+#define PAGE_CACHE_HIGH 48
+
+/**
+ * @brief Sizing of the pool of pre-zeroed pages.
+ *
+ * Zeroing a page is the most expensive part of allocating it, so the kernel
+ * worker thread keeps up to `ZEROED_POOL_SIZE` pages zeroed ahead of time.
+ * When an allocation leaves fewer than `ZEROED_POOL_LOW` of them, the pool is
+ * topped up again in the background.
+ */
+#define ZEROED_POOL_SIZE 32
+#define ZEROED_POOL_LOW 8
+
 /**
  * @brief Allocates a contiguous block of physical memory pages.
  *
  * @param n The number of pages to allocate.
  * @return The starting physical address (`paddr_t`) of the allocated memory block.
  *
- * @note The function maintains a static pointer (`next_paddr`) to track the
- * next available physical address for allocation.
+ * @note Single-page allocations are served from the calling hart's page cache,
+ * which is refilled from the global pool in batches of pages when it runs empty.
+ * @note Multi-page allocations must be physically contiguous, so they are carved
+ * directly from the never-used part of free RAM (`next_paddr`) under the global lock.
  * @note If there is not enough free memory available, the function triggers
  * a system panic (`PANIC("out of memory")`).
- * @note The allocated memory is zero-initialized using `memset`.
- *
- * @warning This function does not implement deallocation. Once allocated,
- * the memory cannot be freed.
+ * @note The allocated memory is zero-initialized. Single pages are taken from the
+ * pool of pages pre-zeroed by the kernel worker when possible, and zeroed with
+ * `memset` otherwise.
  *
  * @example
  * @code
@@ -23,3 +59,33 @@
  * @endcode
  */
 paddr_t alloc_pages(uint32_t n);
+
+/**
+ * @brief Returns a block of physical memory pages to the allocator.
+ *
+ * Each page of the block is pushed onto the calling hart's page cache. When the
+ * cache grows above `PAGE_CACHE_HIGH`, a batch of pages is drained back to the
+ * global free list so that other harts can use them.
+ *
+ * @param paddr Starting physical address of the block (must be page aligned).
+ * @param n     Number of pages in the block.
+ *
+ * @note Freed pages are reused as single pages; a block freed here is not
+ * guaranteed to be handed out contiguously again.
+ *
+ * @example
+ * @code
+ * paddr_t page = alloc_pages(1);
+ * free_pages(page, 1);
+ * @endcode
+ */
+void free_pages(paddr_t paddr, uint32_t n);
+
+/**
+ * @brief Copies the page cache statistics of every hart.
+ *
+ * @param stats Array of entries, indexed by hart ID, to fill.
+ * @param n     Number of entries in `stats`.
+ * @return The number of entries written (at most `HARTS_MAX`).
+ */
+size_t page_cache_stats(struct pagestat *stats, size_t n);
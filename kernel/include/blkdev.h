@@ -0,0 +1,199 @@
+#pragma once
+#include "stat.h"
+#include "types.h"
+
+/**
+ * @brief Generic block device layer.
+ *
+ * Every block device (a virtio disk, the scratch stripe, a RAM disk) fills in
+ * a `struct blkdev` and registers it with `blkdev_register()`. Users such as
+ * the file system and `SYS_DISKREAD` only see the `blkdev_*()` functions, so
+ * they run unchanged on any backend. These functions also keep the I/O
+ * statistics of every device (`blkdev_iostat()`).
+ */
+
+/** Block device sector size in bytes */
+#define SECTOR_SIZE 512
+
+/** Maximum number of registered block devices */
+#define BLKDEV_MAX 16
+
+struct blkdev;
+
+/**
+ * @struct blkdev_ops
+ * @brief Operations of a block device backend.
+ *
+ * Sectors are `SECTOR_SIZE` bytes. Ranges are checked against
+ * `blkdev::capacity` before an operation is called. All operations return
+ * true on success. Optional operations may be NULL.
+ */
+struct blkdev_ops {
+    /** Reads `count` sectors starting at `sector` into `buf`. */
+    bool (*read)(struct blkdev *dev, void *buf, unsigned sector, unsigned count);
+    /** Writes `count` sectors starting at `sector` from `buf`. */
+    bool (*write)(struct blkdev *dev, const void *buf, unsigned sector, unsigned count);
+    /** Makes completed writes durable. Optional: NULL if there is no write cache. */
+    bool (*flush)(struct blkdev *dev);
+    /** Hints that sectors are no longer in use. Optional: NULL ignores the hint. */
+    bool (*discard)(struct blkdev *dev, unsigned sector, unsigned count);
+    /** Sets sectors to zero. Optional: NULL writes zeroed buffers instead. */
+    bool (*write_zeroes)(struct blkdev *dev, unsigned sector, unsigned count);
+};
+
+/**
+ * @struct blkdev_stats
+ * @brief I/O counters of a block device, as reported in `struct iostat`.
+ *
+ * Times are in `time` CSR ticks; `blkdev_iostat()` converts them.
+ */
+struct blkdev_stats {
+    uint32_t ops[IOSTAT_OPS];      ///< Completed operations, by type.
+    uint32_t sectors[IOSTAT_OPS];  ///< Sectors transferred, by type.
+    uint32_t errors;               ///< Operations that failed.
+    uint32_t inflight;             ///< Requests in flight.
+    uint32_t inflight_max;         ///< Most requests ever in flight at once.
+    uint64_t busy;                 ///< Length of the finished busy periods.
+    uint64_t busy_since;           ///< Start of the current busy period, while `inflight` is not 0.
+    uint64_t latency[IOSTAT_OPS];  ///< Time the operations took, by type.
+    uint32_t histogram[IOSTAT_OPS][IOSTAT_BUCKETS];  ///< Latencies by type in log2 microsecond buckets.
+};
+
+/**
+ * @struct blkdev
+ * @brief A registered block device.
+ */
+struct blkdev {
+    const char *name;              ///< Short name for messages, e.g. "virtio0".
+    const struct blkdev_ops *ops;  ///< Operations of the backend.
+    void *priv;                    ///< Backend state.
+    unsigned capacity;             ///< Capacity in sectors.
+    unsigned queue_depth;          ///< Requests the backend can have in flight at once (1 if synchronous).
+    unsigned handle;               ///< Handle assigned by `blkdev_register()`.
+    bool counts_requests;          /**< The backend reports the requests it issues with `blkdev_request_start()`
+                                    *   and `blkdev_request_end()`; otherwise each call is one request. */
+    struct blkdev_stats stats;     ///< I/O counters, kept by the `blkdev_*()` functions.
+};
+
+/**
+ * @brief Registers a block device under the next free handle.
+ *
+ * Handles are assigned in registration order, starting at 0.
+ *
+ * @param dev The device, with all fields but `handle` filled in. Must stay valid forever.
+ * @return The handle.
+ */
+unsigned blkdev_register(struct blkdev *dev);
+
+/**
+ * @brief Returns a block device by handle.
+ *
+ * @param handle The handle from `blkdev_register()`.
+ * @return The device, or NULL if there is no such device.
+ */
+struct blkdev *blkdev_get(unsigned handle);
+
+/**
+ * @brief Returns the number of registered block devices.
+ */
+unsigned blkdev_count(void);
+
+/**
+ * @brief Reads consecutive sectors.
+ *
+ * @param dev    The device.
+ * @param buf    Buffer of `count * SECTOR_SIZE` bytes (kernel or current process memory).
+ * @param sector First sector.
+ * @param count  Number of sectors.
+ * @return True on success; false if the range exceeds the device or the backend failed.
+ */
+bool blkdev_read(struct blkdev *dev, void *buf, unsigned sector, unsigned count);
+
+/**
+ * @brief Writes consecutive sectors.
+ *
+ * @param dev    The device.
+ * @param buf    Buffer of `count * SECTOR_SIZE` bytes (kernel or current process memory).
+ * @param sector First sector.
+ * @param count  Number of sectors.
+ * @return True on success; false if the range exceeds the device or the backend failed.
+ */
+bool blkdev_write(struct blkdev *dev, const void *buf, unsigned sector, unsigned count);
+
+/**
+ * @brief Makes all completed writes durable.
+ *
+ * @param dev The device.
+ * @return True on success.
+ */
+bool blkdev_flush(struct blkdev *dev);
+
+/**
+ * @brief Tells the device that a range of sectors is no longer in use.
+ *
+ * The contents of discarded sectors are undefined afterwards.
+ *
+ * @param dev    The device.
+ * @param sector First sector.
+ * @param count  Number of sectors.
+ * @return True on success.
+ */
+bool blkdev_discard(struct blkdev *dev, unsigned sector, unsigned count);
+
+/**
+ * @brief Sets a range of sectors to zero.
+ *
+ * Backends without `write_zeroes` get a zeroed page written over the range.
+ *
+ * @param dev    The device.
+ * @param sector First sector.
+ * @param count  Number of sectors.
+ * @return True on success.
+ */
+bool blkdev_write_zeroes(struct blkdev *dev, unsigned sector, unsigned count);
+
+/**
+ * @brief Accounts for a request a backend issues to its device.
+ *
+ * For backends that set `counts_requests`: the depth and busy time of the
+ * device follow its requests rather than the `blkdev_*()` calls.
+ *
+ * @param dev The device.
+ */
+void blkdev_request_start(struct blkdev *dev);
+
+/**
+ * @brief Accounts for a request the device has completed.
+ *
+ * @param dev The device.
+ */
+void blkdev_request_end(struct blkdev *dev);
+
+/**
+ * @brief Counts a completed operation of a device.
+ *
+ * `blkdev_read()`, `blkdev_write()` and `blkdev_flush()` call it; a backend
+ * that passes work on to other devices without going through them (the
+ * stripe) calls it for those devices.
+ *
+ * @param dev   The device.
+ * @param op    `IOSTAT_READ`, `IOSTAT_WRITE` or `IOSTAT_FLUSH`.
+ * @param count Number of sectors transferred.
+ * @param start Time in ticks the operation started at.
+ * @param ok    Result of the operation.
+ * @return `ok`.
+ */
+bool blkdev_account(struct blkdev *dev, unsigned op, unsigned count, uint64_t start, bool ok);
+
+/**
+ * @brief Copies the I/O statistics of all block devices.
+ *
+ * Reads, writes and flushes are counted as they pass through `blkdev_read()`,
+ * `blkdev_write()` and `blkdev_flush()`. Reads and writes of a stripe are
+ * counted on the stripe and, piece by piece, on its member disks.
+ *
+ * @param stats Buffer to fill, one entry per device, in handle order.
+ * @param n     Number of entries `stats` can hold.
+ * @return The number of entries written.
+ */
+size_t blkdev_iostat(struct iostat *stats, size_t n);
@@ -0,0 +1,76 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief Nanoseconds, microseconds and milliseconds per second.
+ */
+#define NSEC_PER_SEC 1000000000ull
+#define USEC_PER_SEC 1000000ull
+#define MSEC_PER_SEC 1000ull
+
+/**
+ * @brief Fallback `time` CSR frequency, used if the device tree does not provide one.
+ *
+ * QEMU's `virt` machine drives the timer with a fixed 10 MHz clock.
+ */
+#define TIMEBASE_FREQ_DEFAULT 10000000
+
+/**
+ * @brief `scounteren` bits that expose the cycle, time and instret counters to user mode.
+ */
+#define SCOUNTEREN_CY (1 << 0)
+#define SCOUNTEREN_TM (1 << 1)
+#define SCOUNTEREN_IR (1 << 2)
+
+/**
+ * @brief Frequency of the `time` CSR in ticks per second.
+ *
+ * Read from the `/cpus/timebase-frequency` device tree property by `init_clock()`.
+ */
+extern uint32_t timebase_freq;
+
+/**
+ * @brief Calibrates the clock from the device tree.
+ *
+ * Also grants user mode direct read access to the `cycle`, `time` and `instret`
+ * counters.
+ *
+ * Must be called after `init_fdt()` and before any other function of this module.
+ */
+void init_clock(void);
+
+/**
+ * @brief Reads the current time.
+ *
+ * Reads the 64-bit `time` CSR on RV32 as two halves, retrying if the upper half
+ * changed in between. The clock is monotonic and starts at 0 at reset.
+ *
+ * @return The current time in `time` CSR ticks (`timebase_freq` per second).
+ */
+uint64_t get_time(void);
+
+/**
+ * @brief Converts nanoseconds to `time` CSR ticks, rounding up.
+ *
+ * Rounding up guarantees that a sleep never ends early.
+ *
+ * @param ns Duration or absolute time in nanoseconds.
+ * @return The same duration in ticks.
+ */
+uint64_t ns_to_ticks(uint64_t ns);
+
+/**
+ * @brief Converts `time` CSR ticks to nanoseconds, rounding down.
+ *
+ * @param ticks Duration or absolute time in ticks.
+ * @return The same duration in nanoseconds.
+ */
+uint64_t ticks_to_ns(uint64_t ticks);
+
+/**
+ * @brief Converts milliseconds to `time` CSR ticks.
+ *
+ * @param ms Duration in milliseconds.
+ * @return The same duration in ticks.
+ */
+uint64_t ms_to_ticks(uint64_t ms);
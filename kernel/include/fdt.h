@@ -0,0 +1,96 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief Minimal reader for the flattened device tree (FDT / DTB) blob.
+ *
+ * OpenSBI passes the physical address of the device tree in `a1` when it jumps
+ * to the kernel. The blob describes the machine: CPU timer frequency, memory,
+ * devices and the kernel command line (`/chosen/bootargs`).
+ *
+ * All values in the blob are big-endian. The blob lives outside the memory the
+ * kernel maps into process page tables, so it must only be read during boot,
+ * before the first switch to a process.
+ *
+ * @link https://devicetree-specification.readthedocs.io/en/stable/flattened-format.html
+ */
+#define FDT_MAGIC 0xd00dfeed
+
+#define FDT_BEGIN_NODE 1  ///< Start of a node; followed by its NUL-terminated name.
+#define FDT_END_NODE 2    ///< End of the current node.
+#define FDT_PROP 3        ///< Property; followed by length, name offset and value.
+#define FDT_NOP 4         ///< Ignored.
+#define FDT_END 9         ///< End of the structure block.
+
+/**
+ * @struct fdt_header
+ * @brief Header at the start of a device tree blob (all fields big-endian).
+ */
+struct fdt_header {
+    uint32_t magic;              ///< Must be `FDT_MAGIC`.
+    uint32_t totalsize;          ///< Size of the whole blob in bytes.
+    uint32_t off_dt_struct;      ///< Offset of the structure block.
+    uint32_t off_dt_strings;     ///< Offset of the strings block (property names).
+    uint32_t off_mem_rsvmap;     ///< Offset of the memory reservation block.
+    uint32_t version;            ///< Format version.
+    uint32_t last_comp_version;  ///< Lowest compatible format version.
+    uint32_t boot_cpuid_phys;    ///< Physical ID of the boot hart.
+    uint32_t size_dt_strings;    ///< Size of the strings block.
+    uint32_t size_dt_struct;     ///< Size of the structure block.
+};
+
+/**
+ * @brief Converts a big-endian 32-bit device tree value to host order.
+ *
+ * @param p Pointer to the (possibly unaligned) big-endian value.
+ * @return The value in host (little-endian) order.
+ */
+uint32_t fdt32(const void *p);
+
+/**
+ * @brief Records the location of the device tree blob.
+ *
+ * @param dtb Physical address of the blob, as passed by OpenSBI in `a1`.
+ *
+ * @note If the blob is missing or invalid, every lookup returns NULL and
+ * callers fall back to their defaults.
+ */
+void init_fdt(paddr_t dtb);
+
+/**
+ * @brief Looks up a property of a device tree node by path.
+ *
+ * @param path Absolute node path such as `"/cpus"` or `"/chosen"`. A path
+ *             component without a unit address (`"virtio_mmio"`) also matches
+ *             nodes with one (`"virtio_mmio@10001000"`); the first match wins.
+ * @param name Property name such as `"timebase-frequency"`.
+ * @param len  If not NULL, receives the length of the property value in bytes.
+ * @return Pointer to the property value inside the blob, or NULL if not found.
+ *
+ * @example
+ * @code
+ * uint32_t len;
+ * const void *freq = fdt_getprop("/cpus", "timebase-frequency", &len);
+ * if (freq && len == 4)
+ *     INFO("timebase: %d Hz", fdt32(freq));
+ * @endcode
+ */
+const void *fdt_getprop(const char *path, const char *name, uint32_t *len);
+
+/**
+ * @brief Looks up a `key=value` argument of the kernel command line.
+ *
+ * The command line is the `/chosen/bootargs` property, set e.g. with QEMU's
+ * `-append`. Arguments are separated by spaces.
+ *
+ * @param key Argument name without the `=`, such as `"init"`.
+ * @param len Receives the length of the value (it is not NUL-terminated).
+ * @return Pointer to the value, or NULL if the argument is not given.
+ *
+ * @example
+ * @code
+ * uint32_t len;
+ * const char *init = fdt_bootarg("init", &len);
+ * @endcode
+ */
+const char *fdt_bootarg(const char *key, uint32_t *len);
@@ -1,7 +1,7 @@
 #pragma once
 #include "arg.h"
 #include "types.h"
-#include "virtio_disk.h"
+#include "blkdev.h"
 
 /**
  * @brief Constants related to file storage on disk.
@@ -75,13 +75,15 @@ struct file {
 struct file *fs_lookup(const char *filename);
 
 /**
- * @brief Initialize the in-memory file system by loading files from the virtual disk.
+ * @brief Initialize the in-memory file system by loading files from its block device.
  *
- * This function reads the entire virtual disk into memory, then parses a TAR archive format
+ * The file system lives on block device 0, the primary virtio disk, or on the
+ * RAM disk if the kernel command line has `fs=ram` (`make FS_RAMDISK=1`). This
+ * function reads the start of that device into memory, then parses a TAR archive format
  * stored on the disk to populate the `files[]` array with file metadata and contents.
  *
  * Steps:
- * 1. Read each sector of the virtual disk into memory (`disk[]` array).
+ * 1. Read the device into memory (`disk[]` array) with `blkdev_read()`.
  * 2. Iterate over the TAR archive headers to extract file data.
  * 3. For each valid TAR header:
  *    - Validate using the "ustar" magic string.
@@ -97,12 +99,12 @@ struct file *fs_lookup(const char *filename);
 void init_fs(void);
 
 /**
- * @brief Flush the in-memory file system to the virtual disk in TAR format.
+ * @brief Flush the in-memory file system to its block device in TAR format.
  *
  * This function serializes all in-use files from the `files[]` array into the `disk[]` buffer
  * using a simplified USTAR (Unix Standard TAR) format. After building the archive in memory,
- * it writes the entire `disk[]` buffer to the underlying virtual block device using
- * `read_write_disk()`.
+ * it writes the used part of the `disk[]` buffer to the underlying block device using
+ * `blkdev_write()`.
  *
  * Steps:
  * 1. Clear the `disk[]` buffer to start with a clean slate.
@@ -112,9 +114,28 @@ void init_fs(void);
  *    - Compute the checksum of the TAR header.
  *    - Copy the file content immediately after the header.
  *    - Advance the write offset to the next 512-byte aligned TAR block.
- * 3. Write the final `disk[]` buffer to disk sector-by-sector.
+ * 3. Write the archive part of `disk[]` to the device with `blkdev_write()`.
+ * 4. Write the two end-of-archive blocks with `blkdev_write_zeroes()`.
+ * 5. Discard the sectors the previous archive used beyond the new one with `blkdev_discard()`.
+ * 6. Issue `blkdev_flush()` so the archive survives a power loss.
  *
  * @note The TAR headers and data are aligned to SECTOR_SIZE (typically 512 bytes),
  *       following the convention of block-based archive formats.
  */
 void flush_fs(void);
+
+/**
+ * @brief Schedules a write-back of the file system to disk.
+ *
+ * The write-back (`flush_fs()`) runs later on the kernel worker thread, so the
+ * caller does not wait for the disk. Requests made before the write-back has
+ * started are merged into one.
+ */
+void flush_fs_async(void);
+
+/**
+ * @brief Waits until any scheduled write-back has reached the disk.
+ *
+ * @note Must be called from a process, e.g. before powering off.
+ */
+void sync_fs(void);
@@ -0,0 +1,73 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief Platform-Level Interrupt Controller (PLIC) of the QEMU `virt` machine.
+ *
+ * The PLIC routes device interrupt lines (IRQs) to hart contexts. Each hart has
+ * two contexts: machine mode (`2 * hart`) and supervisor mode (`2 * hart + 1`).
+ * The kernel only uses the supervisor contexts.
+ *
+ * Register map (offsets from `PLIC_PADDR`):
+ * - `0x000000 + 4 * irq`:            Priority of an IRQ (0 = never delivered).
+ * - `0x002000 + 0x80 * ctx`:         Enable bits of a context (one bit per IRQ).
+ * - `0x200000 + 0x1000 * ctx`:       Priority threshold of a context.
+ * - `0x200004 + 0x1000 * ctx`:       Claim/complete register of a context.
+ */
+#define PLIC_PADDR 0x0c000000
+
+#define PLIC_PRIORITY(irq) (PLIC_PADDR + 4 * (irq))
+#define PLIC_SENABLE(hart) (PLIC_PADDR + 0x2080 + 0x100 * (hart))
+#define PLIC_STHRESHOLD(hart) (PLIC_PADDR + 0x201000 + 0x2000 * (hart))
+#define PLIC_SCLAIM(hart) (PLIC_PADDR + 0x201004 + 0x2000 * (hart))
+
+/** IRQ number of the NS16550A UART (console). */
+#define UART0_IRQ 10
+
+/** IRQ number of a virtio-mmio slot (`VIRTIO_MMIO_PADDR(slot)`). */
+#define VIRTIO_MMIO_IRQ(slot) (1 + (slot))
+
+/**
+ * @brief Initializes the PLIC for the calling hart.
+ *
+ * Sets the supervisor-context priority threshold of the hart to 0 so that
+ * every enabled IRQ with a non-zero priority is delivered, and enables
+ * supervisor external interrupts (`sie.SEIE`).
+ */
+void init_plic(void);
+
+/**
+ * @brief Enables an IRQ for the supervisor context of the calling hart.
+ *
+ * @param irq      The device IRQ number (1-1023).
+ * @param priority The priority of the IRQ (1-7, higher wins). A priority of 0
+ *                 disables the IRQ.
+ */
+void plic_enable(uint32_t irq, uint32_t priority);
+
+/**
+ * @brief Claims the highest-priority pending IRQ for the calling hart.
+ *
+ * @return The claimed IRQ number, or 0 if no IRQ is pending.
+ *
+ * @note Every claimed IRQ must be passed to `plic_complete()` once its device
+ * has been serviced, otherwise the PLIC will not deliver it again.
+ */
+uint32_t plic_claim(void);
+
+/**
+ * @brief Signals the PLIC that a claimed IRQ has been serviced.
+ *
+ * @param irq The IRQ number previously returned by `plic_claim()`.
+ */
+void plic_complete(uint32_t irq);
+
+/**
+ * @brief Maps the PLIC registers used by the kernel into a page table.
+ *
+ * Traps run on the page table of the interrupted process, so every process
+ * needs the PLIC mapped (kernel-only) to claim and complete interrupts.
+ *
+ * @param page_table Root page table to map the registers into.
+ */
+void map_plic(uint32_t *page_table);
@@ -1,5 +1,10 @@
 #pragma once
+#include "ring.h"
+#include "stat.h"
+#include "timer.h"
 #include "types.h"
+#include "vdso.h"
+#include "wait.h"
 
 /**
  * @def PROCS_MAX
@@ -21,6 +26,14 @@
 
 #define PROC_EXITED 2  // Exited process
 
+/**
+ * @def PROC_BLOCKED
+ * @brief Indicates that the process sleeps on a wait queue and must not be scheduled.
+ *
+ * @see sleep_on
+ */
+#define PROC_BLOCKED 3  // Blocked process
+
 /**
  * @struct process
  * @brief Represents a process control block (PCB) in the operating system.
@@ -34,8 +47,26 @@ struct process {
     int pid;               ///< Unique process identifier assigned by the kernel.
     int state;             ///< Process state (e.g., PROC_UNUSED, PROC_RUNNABLE, etc.).
     vaddr_t sp;            ///< Saved stack pointer (virtual address) for context switching.
-    uint32_t *page_table;  ///< Pointer to the root page table of the process (Sv32).
-    uint8_t stack[8192];   ///< Kernel stack used during system calls and interrupts (8 KB).
+    uint32_t *page_table;  ///< Pointer to the root page table of the process (Sv32), or NULL for kernel threads.
+    void (*kthread_fn)(void *);  ///< Entry point of a kernel thread (see `create_kthread()`).
+    void *kthread_arg;           ///< Argument passed to `kthread_fn`.
+    struct process *wait_next;  ///< Next process on the same wait queue (see `struct wait_queue`).
+    struct wait_queue *wait_queue;  ///< Wait queue the process is blocked on, or NULL.
+    struct timer wait_timer;        ///< Ends a `sleep_on_timeout()` when the deadline passes.
+    bool timed_out;                 ///< Set if the last `sleep_on_timeout()` ended by timeout.
+    uint64_t utime;       ///< Time spent in user mode, in `time` CSR ticks.
+    uint64_t stime;       ///< Time spent in the kernel, in `time` CSR ticks.
+    uint64_t acct_stamp;  ///< Time up to which `utime`/`stime` have been charged.
+    uint32_t nvcsw;       ///< Voluntary context switches.
+    uint32_t nivcsw;      ///< Involuntary context switches.
+    struct ring_state ring;  ///< Submission/completion rings (see `SYS_RING_SETUP`).
+    struct vdso_proc *vdso;  ///< Kernel address of the per-process vDSO page, or NULL for kernel threads.
+    struct process *parent;  ///< Process that spawned this one (see `SYS_SPAWN`), or NULL.
+    struct wait_queue child_wait;  ///< The process, while waiting for a child to exit (see `SYS_WAIT`).
+    uint8_t stack[8192] __attribute__((aligned(16)));  ///< Kernel stack used during system calls and interrupts (8 KB),
+                                                      ///< 16-byte aligned as the calling convention requires.
+    uint32_t hartid;       ///< Hart the process was last scheduled on. Must directly follow `stack`:
+                           ///< `sscratch` points here, and `trampoline()` reloads `tp` from it.
 };
 
 __attribute__((naked))
@@ -90,7 +121,8 @@ switch_context(uint32_t *prev_sp,
  * - Setting up an initial kernel stack frame for context switching.
  * - Allocating and initializing a new page table.
  * - Mapping both kernel memory and user memory.
- * - Mapping virtio block device memory for I/O.
+ * - Mapping virtio block device, UART and PLIC memory for I/O and interrupts.
+ * - Mapping the read-only vDSO data pages (see `map_vvar()`).
  * - Copying the user program image into memory.
  * - Returning a pointer to the newly created process.
  *
@@ -99,13 +131,56 @@ switch_context(uint32_t *prev_sp,
  * @param base_addr   Virtual base address where the image should be loaded.
  * @param pc          Initial program counter (entry point) for the process.
  *
- * @return Pointer to the initialized `struct process`.
+ * @return Pointer to the initialized `struct process`, or NULL if all process slots are in use.
  *
  * @note The created process is set to `PROC_RUNNABLE` and is ready to be scheduled.
  *       It can access the virtio block device via memory-mapped I/O.
  */
 struct process *create_process(const void *image, size_t image_size, const vaddr_t base_addr, const vaddr_t pc);
 
+/**
+ * @brief Creates a kernel thread.
+ *
+ * A kernel thread is scheduled like a process but runs `fn(arg)` in supervisor
+ * mode and has no address space of its own: it borrows the page table of
+ * whatever ran before it (every page table maps the kernel), so `yield()` skips
+ * the `satp` write and TLB flushes when switching to it.
+ *
+ * @param fn  Entry point. If it returns, the thread exits.
+ * @param arg Argument passed to `fn`.
+ * @return Pointer to the new thread's `struct process`, ready to be scheduled.
+ *
+ * @note Kernel threads run with interrupts disabled like all kernel code, so
+ * they must block (e.g. with `sleep_on()`) or `yield()` to let others run.
+ */
+struct process *create_kthread(void (*fn)(void *), void *arg);
+
+__attribute__((noreturn))
+/**
+ * @brief Terminates the current process or kernel thread.
+ *
+ * Cancels its ring operations in flight, marks it `PROC_EXITED`, wakes up its
+ * parent if it waits for a child and switches away for good. Its memory and process
+ * slot are reclaimed later by the kernel worker thread, so the exiting caller
+ * does not pay for it. The slot of a process with a parent is kept until the
+ * parent collects it with `wait_child()` or exits; its own children become
+ * orphans, which are reclaimed without being waited for.
+ */
+void
+exit_process(void);
+
+/**
+ * @brief Waits until a child of the current process has exited, and collects it.
+ *
+ * A child that exited before the call is collected right away. Once
+ * collected, the child's slot and pid are freed for reuse.
+ *
+ * @param pid Process ID of a process spawned by the current one.
+ * @return 0 once the child has exited, or `-ECHILD` if `pid` is not a child
+ *         of the current process.
+ */
+int32_t wait_child(int32_t pid);
+
 /**
  * @brief Initializes the idle process.
  *
@@ -122,6 +197,22 @@ struct process *create_process(const void *image, size_t image_size, const vaddr
  */
 void init_idle_process(void);
 
+__attribute__((noreturn))
+/**
+ * @brief Runs the idle loop of the calling hart.
+ *
+ * The boot context becomes the idle process. It hands the CPU to any runnable
+ * process and, when there is none, programs the earliest pending timer deadline
+ * (or none at all) and parks the hart with `wfi` until an interrupt arrives.
+ * Pending interrupts are then handled directly (the kernel runs with
+ * `sstatus.SIE` clear, so they are not taken as traps), which typically wakes
+ * up a blocked process, and the loop starts over.
+ *
+ * @note Must be called after `init_idle_process()`. Never returns.
+ */
+void
+idle(void);
+
 /**
  * @brief Voluntarily yield the CPU to allow scheduling of another process.
  *
@@ -152,6 +243,43 @@ void init_idle_process(void);
  */
 void yield(void);
 
+/**
+ * @brief Takes the CPU away from the current process at the end of its time slice.
+ *
+ * Like `yield()`, but the switch is counted as involuntary.
+ */
+void preempt(void);
+
+/**
+ * @brief Charges the time since the last accounting point to the current
+ * process as user time. Called when a trap enters the kernel from user mode.
+ */
+void account_trap_enter(void);
+
+/**
+ * @brief Charges the time since the last accounting point to the current
+ * process as kernel time. Called right before a trap returns to user mode.
+ */
+void account_trap_exit(void);
+
+/**
+ * @brief Copies the scheduler statistics of all processes.
+ *
+ * @param stats Buffer to fill, one entry per process slot in use.
+ * @param n     Number of entries `stats` can hold.
+ * @return The number of entries written.
+ */
+size_t proc_stats(struct procstat *stats, size_t n);
+
+/**
+ * @brief Counts the user processes that are ready to run.
+ *
+ * The running process counts as runnable; the idle process does not.
+ *
+ * @return Number of processes in the `PROC_RUNNABLE` state.
+ */
+size_t nr_runnable(void);
+
 /**
  * @brief Returns the currently running process.
  *
@@ -0,0 +1,41 @@
+#pragma once
+#include "blkdev.h"
+#include "types.h"
+
+/**
+ * @brief A block device in memory.
+ *
+ * The RAM disk keeps its sectors in pages from the page allocator and serves
+ * every request with a `memcpy()`, so it takes the device out of the picture
+ * when measuring what the layers above cost. Its contents are lost on reboot.
+ */
+
+/**
+ * @struct ramdisk
+ * @brief A RAM disk.
+ */
+struct ramdisk {
+    uint8_t *data;      ///< The sectors, `sectors * SECTOR_SIZE` bytes.
+    unsigned sectors;   ///< Capacity in sectors.
+    struct blkdev dev;  ///< The RAM disk as a generic block device.
+};
+
+/**
+ * @brief Allocates the RAM disk and registers it as block device "ram0".
+ *
+ * Only if the kernel command line asks for one with `ramdisk=<pages>` (set by
+ * `make FS_RAMDISK=1` or `make RAMDISK_PAGES=<n>`): otherwise the memory and
+ * the copy at boot are not worth it. The RAM disk starts out as a copy of the
+ * leading sectors of block device 0, so that it holds the same file system
+ * archive as the primary disk.
+ *
+ * @note Reads the primary disk, so must run after `init_idle_process()`.
+ */
+void init_ramdisk(void);
+
+/**
+ * @brief Returns the RAM disk.
+ *
+ * @return The RAM disk's block device, or NULL if there is none.
+ */
+struct blkdev *ramdisk_get(void);
@@ -0,0 +1,58 @@
+#pragma once
+#include "ioring.h"
+#include "timer.h"
+#include "types.h"
+#include "wait.h"
+
+/**
+ * @struct ring_timeout
+ * @brief A `RING_OP_TIMEOUT` operation in flight.
+ */
+struct ring_timeout {
+    struct timer timer;  ///< Posts the completion on expiry. `timer.arg` is the owning process.
+    uint32_t user_data;  ///< `user_data` of the submission.
+};
+
+/**
+ * @struct ring_state
+ * @brief Kernel side of a process's submission/completion rings.
+ */
+struct ring_state {
+    struct ioring *shared;  ///< Kernel address of the shared ring page, or NULL before `SYS_RING_SETUP`.
+    uint32_t inflight;      ///< Submitted operations that have not posted a completion yet.
+    struct ring_timeout timeouts[RING_TIMEOUTS_MAX];  ///< Pending timeouts (`timer.pending` marks a slot in use).
+    struct wait_queue wait;  ///< The process, while `SYS_RING_ENTER` waits for completions.
+};
+
+struct process;
+
+/**
+ * @brief Allocates the ring page of the current process and maps it at `RING_VADDR`.
+ *
+ * @return `RING_VADDR`, or `-EBUSY` if the process already has a ring.
+ */
+int32_t ring_setup(void);
+
+/**
+ * @brief Executes queued submissions of the current process and waits for completions.
+ *
+ * Consumes up to `to_submit` entries of the submission queue in order. Every
+ * operation except `RING_OP_TIMEOUT` runs to completion right away. Submission
+ * stops early if the completion queue could overflow. Then, as long as fewer
+ * than `min_complete` completions are queued and operations are still in flight,
+ * the process sleeps.
+ *
+ * @param to_submit    Maximum number of submissions to consume.
+ * @param min_complete Number of queued completions to wait for.
+ * @return The number of submissions consumed, or `-EBADF` without a ring.
+ */
+int32_t ring_enter(uint32_t to_submit, uint32_t min_complete);
+
+/**
+ * @brief Cancels the operations in flight of an exiting process.
+ *
+ * The ring page itself is a user page and is freed with the page table.
+ *
+ * @param proc The exiting process.
+ */
+void ring_release(struct process *proc);
@@ -49,3 +49,68 @@
         uint32_t __tmp = (value);                               \
         __asm__ __volatile__("csrw " #reg ", %0" ::"r"(__tmp)); \
     } while (false)
+
+/**
+ * @brief Maximum number of harts (hardware threads) the kernel keeps per-hart state for.
+ *
+ * The QEMU `virt` machine supports up to 8 harts, which is also the number of
+ * supervisor contexts wired to the PLIC.
+ */
+#define HARTS_MAX 8
+
+/**
+ * @brief Size of a cache line in bytes.
+ *
+ * Per-hart data is aligned to this boundary so that two harts never write to
+ * the same cache line (false sharing).
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief Returns the ID of the hart executing the caller.
+ *
+ * The kernel keeps the hart ID in the `tp` (thread pointer) register. `boot()`
+ * loads it from the value OpenSBI passes in `a0`, and `trampoline()` reloads it
+ * on every trap from user mode, because user code owns `tp` while it runs.
+ *
+ * @return The hart ID of the current hart (`0` to `HARTS_MAX - 1`).
+ *
+ * @example
+ * @code
+ * struct page_cache *pc = &page_caches[cpu_id()];
+ * @endcode
+ */
+#define cpu_id()                                         \
+    ({                                                   \
+        uint32_t __id;                                   \
+        __asm__ __volatile__("mv %0, tp" : "=r"(__id)); \
+        __id;                                            \
+    })
+
+/**
+ * @brief Interrupt bits of the `sie` (enable) and `sip` (pending) CSRs.
+ *
+ * - `SIE_SSIE`: Supervisor software interrupt.
+ * - `SIE_STIE`: Supervisor timer interrupt.
+ * - `SIE_SEIE`: Supervisor external interrupt (from the PLIC).
+ *
+ * The same bit positions are used in `sip` to report pending interrupts.
+ */
+#define SIE_SSIE (1 << 1)
+#define SIE_STIE (1 << 5)
+#define SIE_SEIE (1 << 9)
+
+/**
+ * @brief Interrupt flag of the `scause` CSR.
+ *
+ * When bit 31 of `scause` is set the trap was caused by an interrupt and the
+ * remaining bits hold the interrupt code (`IRQ_S_*`), otherwise it was an exception.
+ */
+#define SCAUSE_INTERRUPT (1u << 31)
+
+/**
+ * @brief Supervisor interrupt codes reported in `scause` (with `SCAUSE_INTERRUPT` set).
+ */
+#define IRQ_S_SOFT 1   ///< Supervisor software interrupt.
+#define IRQ_S_TIMER 5  ///< Supervisor timer interrupt.
+#define IRQ_S_EXT 9    ///< Supervisor external interrupt.
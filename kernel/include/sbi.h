@@ -27,7 +27,7 @@
  *
  * @example
  * @code
- * struct sbiret ret = sbi_call('A', 0, 0, 0, 0, 0, 0, SYS_PUTCHAR);
+ * struct sbiret ret = sbi_call('A', 0, 0, 0, 0, 0, 0, SBI_LEGACY_CONSOLE_PUTCHAR);
  * if (ret.error >= 0) {
  *     printf("Character '%c' written successfully.\n", (char)ret.error);
  * } else {
@@ -41,51 +41,60 @@ struct sbiret {
 };
 
 /**
- * @brief Outputs a single character to the console.
- *
- * This function writes the character `ch` to the standard output (typically a
- * terminal or serial console).
+ * @brief Legacy SBI extension IDs (SBI v0.1) for console output and shutdown.
  *
- * @param[in] ch The character to be printed.
+ * These are firmware interface numbers and unrelated to the kernel's own
+ * `SYS_*` system call numbers.
+ */
+#define SBI_LEGACY_CONSOLE_PUTCHAR 0x01
+#define SBI_LEGACY_SHUTDOWN 0x08
+
+/**
+ * @brief SBI Timer extension ID ("TIME" in ASCII).
+ */
+#define SBI_EXT_TIME 0x54494D45
+
+/**
+ * @brief Programs the timer interrupt of the calling hart.
  *
- * @note This function is implemented using the `sbi_call` function.
+ * Uses the SBI Timer extension (`sbi_set_timer`). The supervisor timer interrupt
+ * (`sip.STIP`) fires once the `time` CSR reaches `stime`. Any pending timer
+ * interrupt is cleared by the call.
  *
- * @return None.
+ * @param[in] stime Absolute deadline in `time` CSR ticks. Passing `UINT64_MAX`
+ *                  (`(uint64_t)-1`) cancels the timer without arming a new one.
  *
  * @example
  * @code
- * putchar('A'); // Prints 'A' to the console
- * putchar('\n'); // Prints a newline character
+ * sbi_set_timer(get_time() + timebase_freq);  // Interrupt in one second
  * @endcode
  */
-void putchar(char ch);
+void sbi_set_timer(uint64_t stime);
 
 /**
- * @brief Reads a single character from the input using an SBI call.
+ * @brief Outputs a single character to the console.
  *
- * This function repeatedly calls the SBI `SYS_GETCHAR` service to retrieve a character
- * from the console input. If no character is available, it yields execution and retries.
+ * This function writes the character `ch` to the standard output (typically a
+ * terminal or serial console).
+ *
+ * @param[in] ch The character to be printed.
  *
  * @note This function is implemented using the `sbi_call` function.
  *
- * @return The character read as an `int32_t`, or a negative error code if the call fails.
+ * @return None.
  *
  * @example
  * @code
- * int32_t ch = getchar();
- * if (ch >= 0) {
- *     printf("Received character: %c\n", (char)ch);
- * } else {
- *     printf("Error reading character\n");
- * }
+ * putchar('A'); // Prints 'A' to the console
+ * putchar('\n'); // Prints a newline character
  * @endcode
  */
-int32_t getchar(void);
+void putchar(char ch);
 
 /**
  * @brief Shuts down the system using an SBI call.
  *
- * This function issues an SBI call with the `SYS_SHUTDOWN` service ID to request
+ * This function issues an SBI call with the `SBI_LEGACY_SHUTDOWN` extension ID to request
  * a system shutdown. It is typically used to terminate the operating system gracefully.
  *
  * After the call, the system is expected to power off or halt depending on the
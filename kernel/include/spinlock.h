@@ -0,0 +1,38 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @struct spinlock
+ * @brief A busy-waiting mutual exclusion lock.
+ *
+ * Protects short critical sections on data shared between harts. The lock is
+ * taken with an atomic swap (`amoswap.w.aq`) and released with a store-release,
+ * so the critical section cannot leak outside the acquire/release pair.
+ *
+ * @note Kernel code runs with interrupts disabled, so a spinlock never needs to
+ * be interrupt-safe on its own.
+ */
+struct spinlock {
+    volatile uint32_t locked;  ///< 1 if the lock is held, 0 otherwise.
+};
+
+/**
+ * @brief Acquires a spinlock, spinning until it becomes available.
+ *
+ * @param lock Pointer to the spinlock to acquire.
+ *
+ * @example
+ * @code
+ * acquire(&pool_lock);
+ * // ... touch shared data ...
+ * release(&pool_lock);
+ * @endcode
+ */
+void acquire(struct spinlock *lock);
+
+/**
+ * @brief Releases a spinlock previously taken with `acquire()`.
+ *
+ * @param lock Pointer to the spinlock to release.
+ */
+void release(struct spinlock *lock);
@@ -0,0 +1,87 @@
+#pragma once
+#include "blkdev.h"
+#include "types.h"
+#include "virtio_disk.h"
+
+/**
+ * @brief RAID-0 striping across several block devices.
+ *
+ * A stripe presents `ndevs` devices as one: the sectors are split into chunks
+ * of `chunk_sectors`, and consecutive chunks go to consecutive devices, round
+ * robin. A large transfer therefore touches all devices, and the pieces of the
+ * different devices are in flight at the same time.
+ *
+ * @code
+ * chunk  = sector / chunk_sectors
+ * device = chunk % ndevs
+ * offset = (chunk / ndevs) * chunk_sectors + sector % chunk_sectors
+ * @endcode
+ *
+ * There is no redundancy: losing one device loses the whole stripe.
+ *
+ * The members are virtio disks rather than generic `struct blkdev`s: reads
+ * and writes submit the pieces of all members with `blk_start()` and collect
+ * them afterwards, which `struct blkdev_ops` (synchronous calls) cannot
+ * express. Flushes and discards, which have no such pipeline, go through the
+ * members' `blkdev_*()` functions.
+ */
+
+/** Maximum number of devices of a stripe */
+#define STRIPE_DEVS_MAX VIRTIO_BLK_DEVS_MAX
+
+/**
+ * Chunk size in sectors. Set with `make STRIPE_CHUNK_SECTORS=<n>`; a transfer
+ * needs at least `ndevs` chunks to keep every device busy.
+ */
+#ifndef STRIPE_CHUNK_SECTORS
+#define STRIPE_CHUNK_SECTORS 64
+#endif
+
+/**
+ * @struct stripe
+ * @brief A RAID-0 array of block devices.
+ */
+struct stripe {
+    struct virtio_blk *devs[STRIPE_DEVS_MAX];  ///< Member devices, in chunk order.
+    unsigned ndevs;                            ///< Number of entries of `devs`; 0 if not set up.
+    unsigned chunk_sectors;                    ///< Chunk size in sectors.
+    unsigned capacity;                         ///< Capacity in sectors: whole chunk rows of the smallest device.
+    struct blkdev dev;                         ///< The stripe as a generic block device.
+};
+
+/**
+ * @brief Sets up a stripe.
+ *
+ * @param s             The stripe.
+ * @param devs          Member devices, in chunk order.
+ * @param ndevs         Number of devices, 1 to `STRIPE_DEVS_MAX`.
+ * @param chunk_sectors Chunk size in sectors, at least 1.
+ *
+ * Also fills in `dev`; registering it is up to the caller.
+ */
+void stripe_init(struct stripe *s, struct virtio_blk **devs, unsigned ndevs, unsigned chunk_sectors);
+
+/**
+ * @brief Reads or writes a run of consecutive sectors of a stripe.
+ *
+ * Splits the run at chunk boundaries and submits the pieces to their devices
+ * with `blk_read_write_pieces()`, which keeps up to `VIRTIO_BLK_REQS_MAX` of
+ * them in flight at once, so that all devices work in parallel.
+ *
+ * @param s        The stripe.
+ * @param buf      Buffer of `count * SECTOR_SIZE` bytes (kernel or current process memory).
+ * @param sector   First sector of the stripe.
+ * @param count    Number of sectors.
+ * @param is_write Set to true to write, false to read.
+ * @return True if every piece succeeded.
+ */
+bool stripe_read_write(struct stripe *s, void *buf, unsigned sector, unsigned count, bool is_write);
+
+/**
+ * @brief Builds the scratch stripe from the scratch disks.
+ *
+ * With at least two virtio block devices besides the primary disk (handle 0),
+ * stripes all of them with `STRIPE_CHUNK_SECTORS` and registers the stripe as
+ * block device "stripe0"; otherwise does nothing.
+ */
+void init_stripe(void);
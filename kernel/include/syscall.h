@@ -0,0 +1,70 @@
+#pragma once
+#include "sys.h"
+#include "trampoline.h"
+#include "types.h"
+
+/**
+ * @brief Signature of a system call handler.
+ *
+ * A handler reads its arguments from `a0`-`a5` of the trap frame and returns
+ * the result, or a negated error number (`-ENOENT`, ...) on failure.
+ */
+typedef int32_t (*syscall_handler_t)(struct trap_frame *f);
+
+/**
+ * @brief Declares the handler `sys_<name>()` of every system call in `SYSCALLS`.
+ */
+#define DECLARE_SYSCALL_HANDLER(nr, name, nargs) int32_t sys_##name(struct trap_frame *f);
+SYSCALLS(DECLARE_SYSCALL_HANDLER)
+
+/**
+ * @brief Common implementation of `SYS_READFILE` and `SYS_WRITEFILE`.
+ *
+ * @param filename Name of the file.
+ * @param buf      Buffer to read into or write from.
+ * @param len      Number of bytes to transfer.
+ * @param is_write True to write the file.
+ * @return Number of bytes transferred, or `-ENOENT` if the file does not exist.
+ */
+int32_t read_write_file(const char *filename, char *buf, int32_t len, bool is_write);
+
+/**
+ * @brief Handles system calls made by user processes.
+ *
+ * Looks up the handler of the system call number in `a7` of the trap frame in
+ * the system call table and stores its return value in `a0`. The table is
+ * generated from `SYSCALLS`, so dispatching is a bounds check and a single
+ * indirect call. The supported system calls are:
+ *
+ * - `SYS_PUTCHAR`: Writes a character (from `a0`) to the console.
+ * - `SYS_GETCHAR`: Reads a character from the console, sleeping until one arrives
+ *   or until the timeout in `a0` (milliseconds, 0 = none) expires (`-ETIMEDOUT`).
+ * - `SYS_EXIT`: Marks the current process as exited and yields the CPU; its memory is reclaimed later.
+ * - `SYS_READFILE`: Reads data from a file specified by `a0` into a buffer at `a1`.
+ * - `SYS_WRITEFILE`: Writes data from a buffer at `a1` to a file specified by `a0`.
+ *   The disk write-back is deferred to the kernel worker thread.
+ * - `SYS_SHUTDOWN`: Waits for pending write-backs, then initiates system shutdown.
+ * - `SYS_PAGESTAT`: Copies up to `a1` `struct pagestat` entries (one per hart) to the buffer at `a0`.
+ * - `SYS_NANOSLEEP`: Sleeps for the 64-bit nanosecond duration in `a0` (low) and `a1` (high),
+ *   or until that absolute time if `a2` has `TIMER_ABSTIME` set.
+ * - `SYS_CLOCK_GETTIME`: Stores the monotonic time in nanoseconds to the `uint64_t` at `a0`.
+ * - `SYS_PROCSTAT`: Copies up to `a1` `struct procstat` entries (one per process) to the buffer at `a0`.
+ * - `SYS_NULL`: Does nothing and returns 0 (system call overhead benchmark).
+ * - `SYS_RING_SETUP`: Maps the submission/completion rings of the process (see `ioring.h`).
+ * - `SYS_RING_ENTER`: Executes up to `a0` queued submissions, then waits until
+ *   `a1` completions are queued.
+ * - `SYS_SPAWN`: Starts the embedded program named by `a0` as a child with argument `a1`;
+ *   returns its pid.
+ * - `SYS_WAIT`: Sleeps until the child with pid `a0` has exited.
+ * - `SYS_SCHED_YIELD`: Switches to another runnable process, if any.
+ *
+ * For `SYS_READFILE` and `SYS_WRITEFILE`:
+ * - `a0`: const char* (filename)
+ * - `a1`: char* (buffer)
+ * - `a2`: int32_t (length to read/write)
+ *
+ * @param f Pointer to the trap frame containing syscall arguments and return values.
+ *
+ * @note An unknown system call number returns `-ENOSYS`.
+ */
+void handle_syscall(struct trap_frame *f);
@@ -0,0 +1,114 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief Length of a scheduler time slice in milliseconds.
+ *
+ * A time slice is only armed while more than one process is runnable; a lone
+ * runnable process (or an idle hart) is never interrupted by the scheduler.
+ */
+#define TIME_SLICE_MS 10
+
+/** Deadline value meaning "no deadline". */
+#define TIMER_NEVER ((uint64_t)-1)
+
+/**
+ * @brief Geometry of the hierarchical timing wheel.
+ *
+ * Pending timers are hashed into `WHEEL_LEVELS` wheels of `WHEEL_SLOTS` slots.
+ * A slot of level 0 spans one wheel tick (about 100 µs, see `init_timer()`), a
+ * slot of level `n` spans `WHEEL_SLOTS^n` wheel ticks. Timers further away than
+ * the wheel covers (about 30 hours) are parked in the last level and re-hashed
+ * when their slot comes up.
+ */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 5
+
+/**
+ * @struct timer
+ * @brief A one-shot kernel timer.
+ *
+ * Embedded by the subsystem that needs a timeout. Once the `time` CSR reaches
+ * `deadline`, `callback` is invoked from the timer interrupt handler with the
+ * timer as argument. Callbacks run in interrupt context and must not sleep.
+ *
+ * Arming and cancelling are O(1): a timer is linked into exactly one wheel
+ * slot and remembers which one.
+ */
+struct timer {
+    uint64_t deadline;                   ///< Absolute expiry time in `time` CSR ticks.
+    void (*callback)(struct timer *);    ///< Function called on expiry.
+    void *arg;                           ///< Opaque argument for the callback.
+    struct timer *next;                  ///< Next timer in the same wheel slot.
+    struct timer *prev;                  ///< Previous timer in the same wheel slot.
+    uint16_t slot;                       ///< Wheel slot (`level * WHEEL_SLOTS + index`) while pending.
+    bool pending;                        ///< True while the timer is armed.
+};
+
+/**
+ * @brief Initializes timer support for the calling hart.
+ *
+ * Derives the wheel resolution from `timebase_freq`, enables supervisor timer
+ * interrupts (`sie.STIE`) and leaves the timer disarmed: nothing is programmed
+ * until a deadline exists.
+ *
+ * @note Must be called after `init_clock()`.
+ */
+void init_timer(void);
+
+/**
+ * @brief Arms a one-shot timer.
+ *
+ * @param t        The timer to arm. `callback` (and `arg`) must be set.
+ * @param deadline Absolute expiry time in `time` CSR ticks.
+ *
+ * @note Re-arming a pending timer moves it to the new deadline.
+ * @note The callback never runs before `deadline`, but may run up to one wheel
+ * tick (about 100 µs) after it.
+ */
+void timer_add(struct timer *t, uint64_t deadline);
+
+/**
+ * @brief Disarms a timer. Does nothing if the timer is not pending.
+ *
+ * @param t The timer to cancel.
+ */
+void timer_cancel(struct timer *t);
+
+/**
+ * @brief Programs the hardware timer for the next deadline of the calling hart.
+ *
+ * The next deadline is the earliest of:
+ * - the next wheel slot that needs attention (a slot of expiring timers, or a
+ *   slot of a higher level whose timers must be moved down), and
+ * - the end of the current time slice, but only while more than one process
+ *   is runnable (otherwise there is no one to switch to).
+ *
+ * If neither exists the timer is disarmed completely, so an idle hart sleeps in
+ * `wfi` until a device interrupt arrives. The SBI is only called when the
+ * deadline actually changes.
+ */
+void timer_reprogram(void);
+
+/**
+ * @brief Starts a new time slice for the process that is about to run.
+ *
+ * Called by the scheduler on every context switch.
+ */
+void timer_new_slice(void);
+
+/**
+ * @brief Timer interrupt handler.
+ *
+ * Runs the callbacks of all expired timers, flags the running process for
+ * preemption if its time slice is over, and programs the next deadline.
+ */
+void timer_intr(void);
+
+/**
+ * @brief Checks and clears the preemption request of the calling hart.
+ *
+ * @return `true` if the running process used up its time slice and should yield.
+ */
+bool timer_need_resched(void);
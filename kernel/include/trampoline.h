@@ -17,8 +17,11 @@
  * - Saved registers (`s0`-`s11`)
  * - Stack pointer (`sp`)
  *
- * @note The structure is marked with `__attribute__((packed))` to ensure
- * there is no unwanted padding between fields.
+ * @note All fields are 32-bit words, so the natural layout has no padding and
+ * the structure is not `packed`: packed fields may be accessed byte by byte on
+ * cores without misaligned access support. A reserved word pads the frame to
+ * 128 bytes so that the kernel stack pointer stays 16-byte aligned, as the
+ * RISC-V calling convention requires.
  *
  * @warning This structure must match the layout expected by the trap
  * handling mechanism. Any changes should be carefully reviewed to
@@ -63,7 +66,37 @@ struct trap_frame {
     uint32_t s10; /**< Saved register */
     uint32_t s11; /**< Saved register */
     uint32_t sp;  /**< Stack pointer */
-} __attribute__((packed));
+    uint32_t reserved; /**< Padding to a 16-byte multiple */
+};
+
+/**
+ * @brief Size of `struct trap_frame` in 32-bit words, as used by `trampoline()`.
+ */
+#define TRAP_FRAME_WORDS 32
+
+/**
+ * @brief Enables the system call fast path of `trampoline()`.
+ *
+ * Set by the build (`make TRAP_FAST_PATH=0` disables it, e.g. to compare the
+ * null system call round trip of both paths with the shell's `nullbench`).
+ */
+#ifndef TRAP_FAST_PATH
+#define TRAP_FAST_PATH 1
+#endif
+
+/**
+ * @brief Handles a supervisor interrupt.
+ *
+ * Called by `handle_trap()` for interrupts taken in user mode, and by the idle
+ * loop for interrupts that became pending while the hart was parked in `wfi`.
+ *
+ * - `IRQ_S_TIMER`: Runs expired timers and checks the time slice (`timer_intr()`).
+ * - `IRQ_S_EXT`: Claims the pending device IRQ from the PLIC, runs its driver
+ *   handler and completes it.
+ *
+ * @param code The interrupt code (`scause` without `SCAUSE_INTERRUPT`).
+ */
+void handle_interrupt(uint32_t code);
 
 __attribute__((naked))
 __attribute__((aligned(4)))
@@ -80,8 +113,14 @@ __attribute__((aligned(4)))
  * @details
  * - The function uses the `sscratch` register to retrieve and temporarily store
  *   the current kernel stack pointer.
- * - It saves 31 general-purpose registers (including all caller- and
- *   callee-saved) onto the stack.
+ * - System calls (`scause == SCAUSE_ECALL`) take a fast path when built with
+ *   `TRAP_FAST_PATH` (the default): only the registers the C code may clobber
+ *   (`ra`, `tp`, `t0`-`t6`, `a0`-`a7`) are saved, and control goes directly to
+ *   `handle_ecall()`. The callee-saved registers are preserved by the C calling
+ *   convention anyway, also across context switches, and `gp` is never used by
+ *   the kernel.
+ * - All other traps save 31 general-purpose registers (including all caller-
+ *   and callee-saved) onto the stack and call `handle_trap()`.
  * - The original `sp` is saved at slot 30 in the trap frame.
  * - The address of `trampoline` must be aligned to 4 bytes so the low 2 bits
  *   of `stvec` can be used to select direct or vectored mode.
@@ -96,3 +135,14 @@ __attribute__((aligned(4)))
  */
 void
 trampoline(void);
+
+/**
+ * @brief Handles a system call trap taken through the fast path of `trampoline()`.
+ *
+ * Charges CPU time like `handle_trap()`, runs the system call and resumes the
+ * user process after the `ecall` instruction.
+ *
+ * @param f Pointer to the trap frame. Only `ra`, `tp`, `t0`-`t6`, `a0`-`a7` and
+ *          `sp` are valid.
+ */
+void handle_ecall(struct trap_frame *f);
@@ -0,0 +1,58 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @brief NS16550A UART of the QEMU `virt` machine, used for console input.
+ *
+ * Console output keeps going through the SBI (`putchar()` in `sbi.c`). Console
+ * input is read directly from the UART so that it can be interrupt driven:
+ * the receive interrupt wakes up processes blocked in `getchar()` instead of
+ * having them poll the SBI in a loop.
+ */
+#define UART0_PADDR 0x10000000
+
+#define UART_RBR 0  ///< Receive buffer register (read).
+#define UART_IER 1  ///< Interrupt enable register.
+#define UART_LSR 5  ///< Line status register.
+
+#define UART_IER_RX_ENABLE (1 << 0)  ///< Interrupt when received data is available.
+#define UART_LSR_RX_READY (1 << 0)   ///< Received data is available in RBR.
+
+/** Size of the console receive ring buffer in bytes (must be a power of 2). */
+#define UART_RX_BUF_SIZE 128
+
+/**
+ * @brief Initializes the UART for interrupt-driven input.
+ *
+ * Enables the receive interrupt of the UART and routes its IRQ through the PLIC.
+ * The baud rate and line settings are left as configured by OpenSBI.
+ */
+void init_uart(void);
+
+/**
+ * @brief UART interrupt handler.
+ *
+ * Drains every received byte into the console ring buffer and wakes up the
+ * processes waiting for console input. Called from the external interrupt handler.
+ */
+void uart_intr(void);
+
+/**
+ * @brief Reads a single character from the console input.
+ *
+ * If no character has been received yet, the current process sleeps on the
+ * console wait queue until the UART interrupt handler delivers one. The CPU is
+ * free for other processes (or the idle hart sits in `wfi`) in the meantime.
+ *
+ * @param deadline Absolute time in `time` CSR ticks after which to give up, or
+ *                 `TIMER_NEVER` to wait for as long as it takes.
+ * @return The character read as an `int32_t`, or -1 if the deadline passed first.
+ *
+ * @example
+ * @code
+ * int32_t ch = getchar(get_time() + ms_to_ticks(1000));
+ * if (ch >= 0)
+ *     printf("Received character: %c\n", (char)ch);
+ * @endcode
+ */
+int32_t getchar(uint64_t deadline);
@@ -1,4 +1,5 @@
 #pragma once
+#include "types.h"
 
 /**
  * @brief Base virtual address for user application images.
@@ -48,7 +49,9 @@
  * required for execution but does not run or initialize the process itself.
  *
  * @details
- * - Loads the user binary from `_binary_build_user_user_bin_start`.
+ * - Loads the shell binary from `_binary_build_user_user_bin_start`, or the
+ *   embedded program named by an `init=<name>` kernel argument (e.g.
+ *   `init=bench` for a headless benchmark run).
  * - Sets up the user-space memory using `USER_BASE` as the virtual base address.
  * - Passes `user_entry` as the entry point, which will be executed later when the
  *   process is scheduled and context-switched into.
@@ -60,3 +63,16 @@
  * @see user_entry
  */
 void init_user(void);
+
+/**
+ * @brief Starts an embedded user program as a child of the current process.
+ *
+ * The embedded programs are the shell (`"shell"`, started at boot) and the
+ * benchmark suite (`"bench"`).
+ *
+ * @param name Name of the program.
+ * @param arg  Argument published in the child's vDSO page (`vdso_proc::arg`).
+ * @return Process ID of the child, `-ENOENT` if there is no such program or
+ *         `-EAGAIN` if all process slots are in use.
+ */
+int32_t spawn_program(const char *name, int32_t arg);
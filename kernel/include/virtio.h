@@ -13,6 +13,21 @@
 /** Number of descriptors in the virtqueue */
 #define VIRTQ_ENTRY_NUM 16
 
+/**
+ * @brief virtio-mmio transport windows of the QEMU `virt` machine.
+ *
+ * `VIRTIO_MMIO_SLOTS` windows of `VIRTIO_MMIO_SIZE` bytes each, starting at
+ * `VIRTIO_MMIO_BASE`. Every window answers with the magic value; an empty one
+ * reports device ID `VIRTIO_DEVICE_NONE`.
+ */
+#define VIRTIO_MMIO_BASE 0x10001000
+#define VIRTIO_MMIO_SIZE 0x1000
+#define VIRTIO_MMIO_SLOTS 8
+#define VIRTIO_MMIO_PADDR(slot) (VIRTIO_MMIO_BASE + (slot) * VIRTIO_MMIO_SIZE)
+
+/** Device ID of an empty virtio-mmio slot */
+#define VIRTIO_DEVICE_NONE 0
+
 /** Device type identifier for VirtIO block device */
 #define VIRTIO_DEVICE_BLK 2
 
@@ -25,6 +40,18 @@
 /** Device ID register: identifies type (2 = block device) */
 #define VIRTIO_REG_DEVICE_ID 0x08
 
+/** Feature bits offered by the device, 32 at a time (selected with `VIRTIO_REG_DEVICE_FEATURES_SEL`) */
+#define VIRTIO_REG_DEVICE_FEATURES 0x10
+
+/** Selects which 32 feature bits `VIRTIO_REG_DEVICE_FEATURES` shows (0: bits 0-31, 1: bits 32-63) */
+#define VIRTIO_REG_DEVICE_FEATURES_SEL 0x14
+
+/** Feature bits accepted by the driver, 32 at a time (selected with `VIRTIO_REG_DRIVER_FEATURES_SEL`) */
+#define VIRTIO_REG_DRIVER_FEATURES 0x20
+
+/** Selects which 32 feature bits `VIRTIO_REG_DRIVER_FEATURES` sets */
+#define VIRTIO_REG_DRIVER_FEATURES_SEL 0x24
+
 /** Selects the current virtqueue being configured */
 #define VIRTIO_REG_QUEUE_SEL 0x30
 
@@ -37,7 +64,7 @@
 /** Memory alignment of the virtqueue structure */
 #define VIRTIO_REG_QUEUE_ALIGN 0x3c
 
-/** Physical page number (PPN) of the virtqueue descriptor table */
+/** Physical page number (PPN) of the virtqueue descriptor table (legacy transport only) */
 #define VIRTIO_REG_QUEUE_PFN 0x40
 
 /** Virtqueue ready register: 1 = ready, 0 = not ready */
@@ -46,6 +73,24 @@
 /** Notify device of a new entry in the specified queue */
 #define VIRTIO_REG_QUEUE_NOTIFY 0x50
 
+/** Interrupt status register: bit 0 = used buffer notification, bit 1 = configuration change */
+#define VIRTIO_REG_INTERRUPT_STATUS 0x60
+
+/** Interrupt acknowledge register: write the handled bits of the interrupt status */
+#define VIRTIO_REG_INTERRUPT_ACK 0x64
+
+/** Physical address of the descriptor table, low and high 32 bits (version 2 transport only) */
+#define VIRTIO_REG_QUEUE_DESC_LOW 0x80
+#define VIRTIO_REG_QUEUE_DESC_HIGH 0x84
+
+/** Physical address of the available ring, low and high 32 bits (version 2 transport only) */
+#define VIRTIO_REG_QUEUE_DRIVER_LOW 0x90
+#define VIRTIO_REG_QUEUE_DRIVER_HIGH 0x94
+
+/** Physical address of the used ring, low and high 32 bits (version 2 transport only) */
+#define VIRTIO_REG_QUEUE_DEVICE_LOW 0xa0
+#define VIRTIO_REG_QUEUE_DEVICE_HIGH 0xa4
+
 /** Device status register: manage negotiation and driver status */
 #define VIRTIO_REG_DEVICE_STATUS 0x70
 
@@ -73,12 +118,41 @@
 /** Descriptor flag: buffer is write-only (used by device to write) */
 #define VIRTQ_DESC_F_WRITE 2
 
+/** Descriptor flag: buffer is a table of further descriptors (indirect descriptors) */
+#define VIRTQ_DESC_F_INDIRECT 4
+
 /** Available ring flag: suppress interrupt after operation (guest to device) */
 #define VIRTQ_AVAIL_F_NO_INTERRUPT 1
 
 /** Used ring flag: suppress notification after device used buffer (device to guest) */
 #define VIRTQ_USED_F_NO_INTERRUPT 1
 
+/** Feature mask of a feature bit number, for the 64-bit feature words */
+#define VIRTIO_FEATURE(bit) (1ull << (bit))
+
+/** Feature bit: descriptors may point to tables of further descriptors */
+#define VIRTIO_RING_F_INDIRECT_DESC 28
+
+/** Feature bit: `used_event` and `avail_event` replace the notification flags */
+#define VIRTIO_RING_F_EVENT_IDX 29
+
+/** Feature bit: the device follows the virtio 1.0 specification (required by the version 2 transport) */
+#define VIRTIO_F_VERSION_1 32
+
+/** Feature bit: the virtqueues use the packed ring layout */
+#define VIRTIO_F_RING_PACKED 34
+
+/** Packed ring descriptor flag: equals the driver's wrap counter while the descriptor is available */
+#define VIRTQ_DESC_F_AVAIL (1 << 7)
+
+/** Packed ring descriptor flag: equals the device's wrap counter once the descriptor is used */
+#define VIRTQ_DESC_F_USED (1 << 15)
+
+/** Packed ring event suppression flags: notify always, never, or at the descriptor in `off_wrap` */
+#define VIRTQ_EVENT_F_ENABLE 0
+#define VIRTQ_EVENT_F_DISABLE 1
+#define VIRTQ_EVENT_F_DESC 2
+
 /**
  * @brief Virtqueue Descriptor structure for VirtIO devices.
  *
@@ -86,7 +160,10 @@
  * Descriptors can be chained together to form complex data structures using the `next` field.
  * This structure is used in the descriptor table of a virtqueue.
  *
- * @note This structure must be packed and laid out exactly as specified by the VirtIO specification.
+ * @note The ring structures below are laid out exactly as specified by the VirtIO specification.
+ * Their members are naturally aligned, so they need no packing, only the alignment the
+ * specification requires of each part (16 for descriptor tables, 2 for the available ring, 4
+ * for the used ring).
  *
  * @link https://blogs.oracle.com/linux/post/introduction-to-VirtIO
  */
@@ -98,7 +175,7 @@ struct virtq_desc {
                      * - `VIRTQ_DESC_F_WRITE` (2): The buffer is write-only for the device (i.e., output buffer).
                      */
     uint16_t next;  ///< Index of the next descriptor in the chain, if `VIRTQ_DESC_F_NEXT` is set.
-} __attribute__((packed));
+} __attribute__((aligned(16)));
 
 /**
  * @brief Virtqueue Available Ring (Driver Area) structure for VirtIO devices.
@@ -120,7 +197,10 @@ struct virtq_avail {
                                       * It increments after each new buffer is made available.
                                       */
     uint16_t ring[VIRTQ_ENTRY_NUM];  ///< Array of descriptor indices representing available buffers.
-} __attribute__((packed));
+    uint16_t used_event;             /**< With `VIRTIO_RING_F_EVENT_IDX`: the device interrupts only once
+                                      *   it writes the used ring entry with this index.
+                                      */
+} __attribute__((aligned(2)));
 
 /**
  * @brief Virtqueue Used Ring element structure.
@@ -138,7 +218,7 @@ struct virtq_used_elem {
     uint32_t len; /**< Number of bytes the device wrote into the total chained buffer (for write operations).
                    *   May be less than or equal to the buffer size originally submitted.
                    */
-} __attribute__((packed));
+};
 
 /**
  * @brief Virtqueue Used Ring (Device Area) structure.
@@ -159,14 +239,52 @@ struct virtq_used {
     struct virtq_used_elem ring[VIRTQ_ENTRY_NUM]; /**< Array of elements indicating which descriptors
                                                    *   have been used and how many bytes were written.
                                                    */
-} __attribute__((packed));
+    uint16_t avail_event;                         /**< With `VIRTIO_RING_F_EVENT_IDX`: the device needs a notification
+                                                   *   only once the driver makes this available ring index visible.
+                                                   */
+} __attribute__((aligned(4)));
+
+/**
+ * @brief Descriptor of a packed virtqueue.
+ *
+ * A packed ring has a single ring of these. The driver makes descriptors
+ * available in ring order and the device overwrites them in place when it
+ * uses them, so the driver and the device share one cache line per request
+ * instead of touching a descriptor table, an available ring and a used ring.
+ * Indirect descriptor tables use the same format.
+ */
+struct virtq_packed_desc {
+    uint64_t addr;   ///< Physical address of the data buffer.
+    uint32_t len;    ///< Length of the buffer; the device writes the number of bytes written when it uses it.
+    uint16_t id;     ///< Buffer id; the device returns it in the used descriptor.
+    uint16_t flags;  ///< `VIRTQ_DESC_F_*`, including the `AVAIL`/`USED` wrap bits.
+} __attribute__((aligned(16)));
+
+/**
+ * @brief Event suppression structure of a packed virtqueue.
+ */
+struct virtq_event_suppress {
+    uint16_t off_wrap;  ///< With `VIRTQ_EVENT_F_DESC`: ring offset (bits 0-14) and wrap counter (bit 15) to be notified at.
+    uint16_t flags;     ///< One of `VIRTQ_EVENT_F_*`.
+} __attribute__((aligned(4)));
+
+/**
+ * @brief Memory layout of a packed virtqueue.
+ */
+struct virtq_packed {
+    struct virtq_packed_desc descs[VIRTQ_ENTRY_NUM];  ///< The descriptor ring.
+    struct virtq_event_suppress driver;               ///< Written by the driver: when the device should interrupt.
+    struct virtq_event_suppress device;               ///< Written by the device: when the driver should notify.
+};
 
 /**
  * @brief Represents a VirtIO virtqueue used for communication between the driver and the device.
  *
  * A virtqueue consists of three main parts: the descriptor table, the available ring (driver to device),
  * and the used ring (device to driver). This structure encapsulates all components along with bookkeeping
- * fields necessary for proper queue operation.
+ * fields necessary for proper queue operation. The three parts are placed as the legacy layout requires
+ * (the available ring right after the descriptors, the used ring on the next page); the bookkeeping
+ * fields are only seen by the driver and keep their natural alignment.
  *
  * @link https://blogs.oracle.com/linux/post/introduction-to-VirtIO
  */
@@ -175,9 +293,20 @@ struct virtio_virtq {
     struct virtq_avail avail;                                   /**< Available ring: driver informs device of ready descriptors. */
     struct virtq_used used __attribute__((aligned(PAGE_SIZE))); /**< Used ring: device informs driver of completed descriptors. */
 
-    int queue_index;               /**< Index of the virtqueue. Used to identify the queue in device registers.
-                                    * For virtio_blk we have only one virtqueue at index 0.
-                                    */
+    int queue_index;               /**< Index of the virtqueue. Used to identify the queue in device registers. */
+    paddr_t regs;                  /**< Base address of the registers of the device the queue belongs to. */
     volatile uint16_t *used_index; /**< Tracks the current position in the used ring. Points to used.index, updated by Device. */
-    uint16_t last_seen_used_index; /**< Tracks the last seen used.index should be. */
-} __attribute__((packed));
+    uint16_t last_seen_used_index; /**< Next used ring entry the driver has not processed yet. */
+    uint16_t free_head;            /**< First descriptor of the free list, chained through `next`. */
+    uint16_t num_free;             /**< Number of descriptors not in use by the device. */
+    bool event_idx;                /**< `VIRTIO_RING_F_EVENT_IDX` was negotiated. */
+    bool indirect;                 /**< `VIRTIO_RING_F_INDIRECT_DESC` was negotiated. */
+    uint16_t head_id[VIRTQ_ENTRY_NUM]; /**< Split ring: buffer id of the chain starting at each descriptor. */
+
+    struct virtq_packed *packed;   /**< Packed ring (`VIRTIO_F_RING_PACKED`), or NULL if the split ring above is used. */
+    uint16_t next_avail;           /**< Packed ring: slot the next available descriptor goes to. */
+    uint16_t next_used;            /**< Packed ring: slot the device writes the next used descriptor to. */
+    bool avail_wrap;               /**< Packed ring: driver's wrap counter, flips whenever `next_avail` wraps. */
+    bool used_wrap;                /**< Packed ring: expected wrap counter of the next used descriptor. */
+    uint16_t chain_len[VIRTQ_ENTRY_NUM]; /**< Packed ring: number of ring slots the chain of each buffer id occupies. */
+};
@@ -1,15 +1,57 @@
 #pragma once
+#include "blkdev.h"
+#include "riscv.h"
 #include "types.h"
+#include "virtio.h"
+#include "wait.h"
 
 /**
  * @brief Definitions and structures for VirtIO block device communication.
  */
 
-/** Physical memory-mapped address for the VirtIO block device registers */
-#define VIRTIO_BLK_PADDR 0x10001000
+/** Maximum number of block devices: one per virtio-mmio slot */
+#define VIRTIO_BLK_DEVS_MAX VIRTIO_MMIO_SLOTS
 
-/** Block device sector size in bytes */
-#define SECTOR_SIZE 512
+/** Time in milliseconds after which a block request that did not complete fails, see `blk_finish()` */
+#define VIRTIO_BLK_TIMEOUT_MS 1000
+
+/**
+ * Number of request slots per queue. With indirect descriptors every request
+ * takes a single ring descriptor, so the whole ring can be in flight; without
+ * them a single-buffer request takes three and descriptors run out first.
+ */
+#define VIRTIO_BLK_REQS_MAX VIRTQ_ENTRY_NUM
+
+/** Maximum number of request queues: one per hart */
+#define VIRTIO_BLK_QUEUES_MAX HARTS_MAX
+
+/** Number of descriptors in the indirect table of a request */
+#define VIRTIO_BLK_INDIRECT_MAX 32
+
+/** Maximum number of data segments of one request: the header and status take a descriptor each */
+#define VIRTIO_BLK_SG_MAX (VIRTIO_BLK_INDIRECT_MAX - 2)
+
+/** Number of sectors `read_write_disk_range()` transfers per request (64 KiB) */
+#define VIRTIO_BLK_RANGE_SECTORS 128
+
+/** Size in bytes of the bounce buffer of a request slot, and so of a bounced request (64 KiB) */
+#define VIRTIO_BLK_BOUNCE_SIZE (VIRTIO_BLK_RANGE_SECTORS * SECTOR_SIZE)
+
+/**
+ * Time in microseconds for which reads and writes wait in the dispatch queue
+ * while the device is busy, so that neighbours arriving meanwhile are sorted
+ * and merged with them. Set with `make VIRTIO_BLK_SCHED_WINDOW_US=<n>`; 0
+ * dispatches every request right away.
+ */
+#ifndef VIRTIO_BLK_SCHED_WINDOW_US
+#define VIRTIO_BLK_SCHED_WINDOW_US 100
+#endif
+
+/** Time in microseconds after which a queued request is dispatched ahead of elevator order */
+#define VIRTIO_BLK_SCHED_DEADLINE_US 2000
+
+/** Maximum number of sectors of a request merged from several (256 KiB) */
+#define VIRTIO_BLK_MERGE_SECTORS 512
 
 /** VirtIO block request types */
 #define VIRTIO_BLK_T_IN 0            /**< Read a sector from the device. */
@@ -18,59 +60,385 @@
 #define VIRTIO_BLK_T_DISCARD 11      /**< Discard (trim) sectors. */
 #define VIRTIO_BLK_T_WRITE_ZEROES 13 /**< Write zeroes to sectors. */
 
+/** VirtIO block feature bits */
+#define VIRTIO_BLK_F_FLUSH 9         /**< The device has a write cache and supports `VIRTIO_BLK_T_FLUSH`. */
+#define VIRTIO_BLK_F_MQ 12           /**< The device has more than one request queue. */
+#define VIRTIO_BLK_F_DISCARD 13      /**< The device supports `VIRTIO_BLK_T_DISCARD`. */
+#define VIRTIO_BLK_F_WRITE_ZEROES 14 /**< The device supports `VIRTIO_BLK_T_WRITE_ZEROES`. */
+
+/** Offsets of VirtIO block configuration fields, relative to `VIRTIO_REG_DEVICE_CONFIG` */
+#define VIRTIO_BLK_CONFIG_CAPACITY 0x00                 /**< Capacity in sectors (64 bits). */
+#define VIRTIO_BLK_CONFIG_NUM_QUEUES 0x22               /**< Number of request queues (16 bits). */
+#define VIRTIO_BLK_CONFIG_MAX_DISCARD_SECTORS 0x24      /**< Maximum sectors of one discard segment. */
+#define VIRTIO_BLK_CONFIG_MAX_WRITE_ZEROES_SECTORS 0x30 /**< Maximum sectors of one write-zeroes segment. */
+#define VIRTIO_BLK_CONFIG_WRITE_ZEROES_MAY_UNMAP 0x38   /**< Non-zero if write-zeroes may deallocate sectors (8 bits). */
+
+/** `virtio_blk_discard_write_zeroes::flags`: the device may deallocate the zeroed sectors */
+#define VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP 1
+
 /**
- * @brief Represents a request to the VirtIO block device.
+ * @brief Header of a request to the VirtIO block device.
  *
- * This structure is used to submit a read or write request to the VirtIO block device.
- * It contains the operation type, target sector, a data buffer, and a status field
- * which is set by the device after the request is completed.
+ * The device sees a request as a descriptor chain: this header, the data
+ * buffers (any number of descriptors whose lengths add up to whole sectors),
+ * and a single status byte which is set by the device after the request is
+ * completed.
  */
 struct virtio_blk_req {
     uint32_t type; /**< Operation code (see VIRTIO_BLK_T_* defines). */
 
     uint32_t reserved; /**< Reserved for future use. Must be set to 0. */
 
-    uint64_t sector; /**< Sector number to read/write.
+    uint64_t sector; /**< First sector to read/write.
                       *   Each sector is 512 bytes.
                       *   Sector n -> byte range: [n * 512, (n + 1) * 512 - 1]
                       */
+} __attribute__((packed));
 
-    uint8_t data[512]; /**< Data buffer for reading from or writing to the sector. */
-
-    uint8_t status; /**< Status returned by the device after processing:
-                     *   - 0: Success
-                     *   - 1: I/O error
-                     *   - 2: Unsupported request
-                     */
+/**
+ * @brief Data of a `VIRTIO_BLK_T_DISCARD` or `VIRTIO_BLK_T_WRITE_ZEROES` request: one range of sectors.
+ */
+struct virtio_blk_discard_write_zeroes {
+    uint64_t sector;       /**< First sector. */
+    uint32_t num_sectors;  /**< Number of sectors. */
+    uint32_t flags;        /**< `VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP` or 0. */
 } __attribute__((packed));
 
 /**
- * @brief Initializes the VirtIO block device.
+ * @brief One buffer of a scatter-gather list.
+ *
+ * The address is virtual: kernel memory, or memory of the current process.
+ * The device accesses the buffer directly, so it must not be freed or
+ * unmapped while the request is in flight.
+ */
+struct blk_sg {
+    void *addr;    ///< Start of the buffer.
+    uint32_t len;  ///< Length in bytes.
+};
+
+/**
+ * @brief A physically contiguous piece of a request's data, as the device sees it.
+ */
+struct blk_seg {
+    paddr_t addr;  ///< Physical start address.
+    uint32_t len;  ///< Length in bytes.
+};
+
+/**
+ * @brief A slot of the driver's request pool.
  *
- * This function performs full initialization of the VirtIO block device according to the VirtIO specification.
- * It validates the device, resets it, performs the feature negotiation handshake, sets up the virtqueue,
+ * The device reads the header (and the indirect descriptor table) and writes
+ * the status in place, so the slot lives in memory allocated with `alloc_pages()`.
+ */
+struct blk_request {
+    struct virtq_desc indirect[VIRTIO_BLK_INDIRECT_MAX] __attribute__((aligned(16)));  ///< Descriptor table with indirect descriptors.
+    struct virtio_blk_req req;  ///< The request header as the device sees it.
+    struct virtio_blk_discard_write_zeroes range;  ///< Data of discard and write-zeroes requests.
+    struct virtio_blk *blk;     ///< The device the slot belongs to.
+    struct virtio_virtq *vq;    ///< The queue the slot belongs to.
+    uint16_t id;                ///< Buffer id of the slot on the ring of `vq`.
+    uint8_t status;             ///< Status written by the device: 0 on success, 1 on I/O error, 2 if unsupported.
+    bool in_use;                ///< Set from allocation until the issuer has collected the result.
+    bool done;                  ///< Set once the device has returned the chain in the used ring.
+    bool abandoned;             ///< The issuer gave up waiting; the slot is freed on completion.
+    paddr_t bounce;             ///< Bounce buffer standing in for the caller's buffers, or 0 for zero-copy.
+    paddr_t bounce_buf;         ///< The slot's own `VIRTIO_BLK_BOUNCE_SIZE` buffer, allocated on first use and kept.
+    const struct blk_sg *sg;    ///< The caller's buffers, to copy a bounced read back into.
+    unsigned nsg;               ///< Number of entries of `sg`.
+    struct blk_seg segs[VIRTIO_BLK_SG_MAX];  ///< Data segments of a read or write, kept until it is dispatched.
+    unsigned nseg;              ///< Number of entries of `segs`.
+    unsigned count;             ///< Number of sectors of a read or write.
+    bool queued;                ///< Waiting in the dispatch queue, not yet on a ring.
+    uint64_t queued_at;         ///< Time it entered the dispatch queue, in `time` CSR ticks.
+    struct blk_request *next;   ///< Next request in the dispatch queue, or in the `merged` list it belongs to.
+    struct blk_request *merged; ///< Requests whose data rides in this request's descriptor chain.
+};
+
+/**
+ * @brief Counters of a device's dispatch queue.
+ */
+struct blk_sched_stats {
+    uint32_t ios;            ///< Reads and writes dispatched.
+    uint32_t requests;       ///< Device requests they went out in; `ios / requests` is the merge ratio.
+    uint32_t expired;        ///< Device requests dispatched ahead of elevator order because of their deadline.
+    uint64_t residency;      ///< Time the reads and writes spent in the queue, summed up, in ticks.
+    uint64_t residency_max;  ///< Longest time one of them spent in the queue, in ticks.
+};
+
+/**
+ * @struct virtio_blk
+ * @brief A VirtIO block device and the driver's state for it.
+ *
+ * Every device has its own queues, request pool and wait queue, so I/O on one
+ * device never waits for another.
+ *
+ * Reads and writes first go to the device's dispatch queue, kept in sector
+ * order. An idle device gets them right away; a busy one gets them after up to
+ * `VIRTIO_BLK_SCHED_WINDOW_US`, so that requests arriving meanwhile from other
+ * processes (or from a caller with several in flight) are merged with their
+ * neighbours into one multi-segment request and dispatched in one upward sweep
+ * over the disk. A request that has waited `VIRTIO_BLK_SCHED_DEADLINE_US` goes
+ * first, so none starves while the rings are full.
+ */
+struct virtio_blk {
+    unsigned handle;                   ///< Index in the device table, see `virtio_blk_get()`.
+    paddr_t regs;                      ///< Base address of the virtio-mmio registers.
+    uint32_t irq;                      ///< Interrupt line of the slot.
+    uint32_t version;                  ///< Transport version: 1 (legacy) or 2 (modern).
+    uint64_t features;                 ///< Feature bits negotiated with the device.
+    unsigned capacity;                 ///< Capacity in bytes.
+    uint32_t max_discard_sectors;      ///< Maximum sectors per discard request.
+    uint32_t max_write_zeroes_sectors; ///< Maximum sectors per write-zeroes request.
+    bool write_zeroes_unmap;           ///< True if write-zeroes may deallocate the sectors.
+    struct virtio_virtq *vqs[VIRTIO_BLK_QUEUES_MAX];  ///< Request queues; each hart submits to its own.
+    unsigned num_queues;               ///< Number of entries of `vqs`.
+    struct blk_request *reqs;          ///< Request pool: `VIRTIO_BLK_REQS_MAX` slots per queue, queue by queue.
+    struct wait_queue wq;              ///< Processes waiting for a request to complete or for a free slot.
+    struct blk_request *sched_queue;   ///< Dispatch queue: reads and writes not yet on a ring, by ascending sector.
+    unsigned sched_head;               ///< Sector after the last dispatched read or write; the sweep goes up from it.
+    unsigned inflight;                 ///< Requests on the rings.
+    struct blk_sched_stats sched_stats;  ///< Counters of the dispatch queue.
+    char name[12];                     ///< Name of the generic device, "virtio<handle>".
+    struct blkdev dev;                 ///< The device as registered with the generic block layer.
+};
+
+/**
+ * @brief Finds and initializes all VirtIO block devices.
+ *
+ * Scans the `VIRTIO_MMIO_SLOTS` virtio-mmio windows in address order, skips
+ * empty slots and devices of other types, and registers every block device
+ * under the next handle, both here and with the generic block layer
+ * (`blkdev_register()`). QEMU puts the device given `bus=virtio-mmio-bus.0`
+ * into the first slot, so the primary disk gets handle 0. Must run before any
+ * other block device is registered, so that both handles agree.
+ *
+ * Each device performs full initialization according to the VirtIO specification.
+ * It validates the device, resets it, performs the feature negotiation handshake, sets up the virtqueues,
  * and prepares memory for sending block requests.
  *
  * Initialization Steps:
- * 1. Validate the VirtIO device using magic value, version, and device ID.
+ * 1. Validate the VirtIO device using magic value, version (1: legacy, 2: modern transport), and device ID.
  * 2. Reset the device and set the ACK and DRIVER status bits to indicate driver presence.
- * 3. Feature negotiation: since no features are used, directly set FEATURES_OK.
- * 4. Initialize the request virtqueue (queue index 0).
+ * 3. Feature negotiation: accept `VIRTIO_F_VERSION_1` (required by the modern transport),
+ *    `VIRTIO_F_RING_PACKED` (modern transport only), `VIRTIO_RING_F_EVENT_IDX`,
+ *    `VIRTIO_RING_F_INDIRECT_DESC`, `VIRTIO_BLK_F_FLUSH`, `VIRTIO_BLK_F_DISCARD`,
+ *    `VIRTIO_BLK_F_WRITE_ZEROES` and `VIRTIO_BLK_F_MQ` where offered, and set FEATURES_OK.
+ * 4. Initialize one request virtqueue per hart, up to the device's `num_queues` (just queue 0
+ *    without `VIRTIO_BLK_F_MQ`): packed rings if negotiated, split rings otherwise.
  * 5. Set the DRIVER_OK bit to signal that the driver is ready.
- * 6. Read block device capacity from configuration space.
- * 7. Allocate memory for block I/O request structure.
+ * 6. Read block device capacity and the discard and write-zeroes limits from configuration space.
+ * 7. Allocate a pool of `VIRTIO_BLK_REQS_MAX` request slots per queue.
+ * 8. Enable the device's interrupt line in the PLIC.
  */
 void init_virtio_blk(void);
 
 /**
- * @brief Performs a read or write operation on the VirtIO block device.
+ * @brief Returns a block device by handle.
  *
- * This function prepares and submits a request to the VirtIO block device to either
- * read from or write to a specific sector. It constructs the required descriptors,
- * submits the request to the device, waits for completion, and then processes the result.
+ * @param handle 0 for the primary disk, then one per further device in slot order.
+ * @return The device, or NULL if there is no such device.
+ */
+struct virtio_blk *virtio_blk_get(unsigned handle);
+
+/**
+ * @brief Returns the number of block devices found by `init_virtio_blk()`.
+ */
+unsigned virtio_blk_count(void);
+
+/**
+ * @brief Handles an interrupt of a VirtIO block device.
+ *
+ * Acknowledges the interrupt, marks every request the device has returned in
+ * the used ring of any queue as done, and wakes up the processes waiting on them.
  *
+ * @param irq The claimed IRQ, `VIRTIO_MMIO_IRQ()` of the device's slot.
+ */
+void virtio_blk_intr(uint32_t irq);
+
+/**
+ * @brief Logs the dispatch queue counters of every block device.
+ *
+ * Prints the merge ratio (reads and writes per device request) and how long
+ * requests waited in the queue, on average and at most.
+ */
+void virtio_blk_report(void);
+
+/**
+ * @brief Reads or writes consecutive sectors with one request spanning a scatter-gather list.
+ *
+ * Builds a single virtio request whose data descriptors point straight at the
+ * buffers of `sg`, in order, so the device transfers directly into or out of
+ * them. Each buffer is translated to physical memory and split where its pages
+ * are not physically contiguous; kernel memory is identity-mapped and needs no
+ * splitting. Only if the pieces do not fit in one request (`VIRTIO_BLK_SG_MAX`
+ * segments with indirect descriptors, two less than the ring size without) is
+ * the data staged in the request slot's contiguous bounce buffer instead,
+ * which limits such a request to `VIRTIO_BLK_BOUNCE_SIZE` bytes. The caller
+ * sleeps until the device signals completion with an interrupt, so other
+ * processes can run in the meantime. Only during boot, before there is
+ * anything else to run, the idle process polls the device instead. The request
+ * goes to the calling hart's queue; up to `VIRTIO_BLK_REQS_MAX` requests of
+ * concurrent callers are in flight on each queue at once. The range is not
+ * checked: `blkdev_*()` check it before they call the driver.
+ *
+ * @param blk      The device.
+ * @param sector   First sector to read/write.
+ * @param sg       Buffers, in disk order. Their lengths must add up to a multiple of `SECTOR_SIZE`.
+ * @param nsg      Number of buffers.
+ * @param is_write Set to true to perform a write operation, false for a read.
+ * @return True on success.
+ *
+ * @note If the device does not complete the request within `VIRTIO_BLK_TIMEOUT_MS`,
+ * the request fails with an error message, unless the device transfers
+ * straight to or from the buffers: then it keeps waiting for the device, as
+ * the buffers must not be reused while the device can still access them.
+ */
+bool read_write_disk_sg(struct virtio_blk *blk, unsigned sector, const struct blk_sg *sg, unsigned nsg, bool is_write);
+
+/**
+ * @brief Submits a read or write without waiting for it.
+ *
+ * For callers that keep several requests in flight, possibly on several
+ * devices. Points the data descriptors straight at the caller's buffers; only
+ * if they are too fragmented for the descriptor budget, the data goes through
+ * the slot's contiguous bounce buffer (at most `VIRTIO_BLK_BOUNCE_SIZE`
+ * bytes). The request goes through the device's dispatch queue and may share
+ * a device request with its neighbours. Every request returned must be passed
+ * to `blk_finish()`. The range is not checked.
+ *
+ * @param blk      The device.
+ * @param sector   First sector to read/write.
+ * @param sg       Buffers, in disk order. Must stay valid until `blk_finish()`.
+ * @param nsg      Number of buffers.
+ * @param len      Total length of the buffers in bytes, a multiple of `SECTOR_SIZE`.
+ * @param is_write Set to true to perform a write operation, false for a read.
+ * @param wait     If true, waits for a free request slot. A caller that holds
+ *                 unfinished requests of the same device must not wait: they
+ *                 keep their slots until it collects them.
+ * @return The submitted request, or NULL if there is no free slot, a buffer is
+ *         not mapped, or too fragmented a buffer exceeds the bounce buffer.
+ */
+struct blk_request *blk_start(struct virtio_blk *blk, unsigned sector, const struct blk_sg *sg, unsigned nsg,
+                              uint32_t len, bool is_write, bool wait);
+
+/**
+ * @brief Waits for a request from `blk_start()`, checks its status and frees its slot.
+ *
+ * Gives up after `VIRTIO_BLK_TIMEOUT_MS` only if the device no longer needs
+ * the caller's buffers: the request was never dispatched, or it was bounced.
+ * A request the device transfers straight to or from the caller's buffers is
+ * waited for without a deadline.
+ *
+ * @param r The request.
+ * @return True if the device completed the request successfully.
+ */
+bool blk_finish(struct blk_request *r);
+
+/**
+ * @brief Reads or writes a single sector.
+ *
+ * @param blk      The device.
  * @param buf      Pointer to the memory buffer to read into or write from (must be 512 bytes).
  * @param sector   Sector number to read/write. Each sector is 512 bytes.
  * @param is_write Set to true to perform a write operation, false for a read.
  */
-void read_write_disk(void *buf, unsigned sector, bool is_write);
+void read_write_disk(struct virtio_blk *blk, void *buf, unsigned sector, bool is_write);
+
+/**
+ * @brief One request of a pipelined transfer: a run of sectors on one device.
+ */
+struct blk_piece {
+    struct virtio_blk *blk;  ///< Device the piece goes to.
+    unsigned sector;         ///< First sector on that device.
+    unsigned count;          ///< Number of sectors, at most `VIRTIO_BLK_RANGE_SECTORS`.
+};
+
+/**
+ * @brief Maps the next part of a pipelined transfer to a device.
+ *
+ * @param ctx   The context passed to `blk_read_write_pieces()`.
+ * @param done  Sectors of the transfer submitted so far; the piece starts there.
+ * @param left  Sectors still to submit, at least 1.
+ * @param piece Receives the piece, of 1 to `left` sectors.
+ */
+typedef void (*blk_piece_fn_t)(void *ctx, unsigned done, unsigned left, struct blk_piece *piece);
+
+/**
+ * @brief Reads or writes a contiguous buffer as a pipeline of requests.
+ *
+ * Asks `next` for one piece of the transfer at a time and submits it right
+ * away, keeping up to `VIRTIO_BLK_REQS_MAX` pieces in flight, possibly on
+ * several devices. Results are collected in submission order. Used by
+ * `read_write_disk_range()` and by the stripe.
+ *
+ * @param next     Maps the transfer to pieces.
+ * @param ctx      Passed to `next`.
+ * @param buf      Buffer of `count * SECTOR_SIZE` bytes; piece after piece.
+ * @param count    Number of sectors of the transfer.
+ * @param is_write Set to true to write, false to read.
+ * @param via      Device the transfer was issued to if the pieces go to other
+ *                 devices (the stripe), or NULL. Each piece is then one of its
+ *                 requests, and a read or write of the piece's device.
+ * @return True if every piece succeeded.
+ */
+bool blk_read_write_pieces(blk_piece_fn_t next, void *ctx, void *buf, unsigned count, bool is_write,
+                           struct blkdev *via);
+
+/**
+ * @brief Reads or writes a run of consecutive sectors into or out of a contiguous buffer.
+ *
+ * Splits the run into requests of `VIRTIO_BLK_RANGE_SECTORS` sectors and keeps
+ * up to `VIRTIO_BLK_REQS_MAX` of them in flight: new ones are submitted back to
+ * back while earlier ones are still being processed, and results are collected
+ * in order. The range is not checked.
+ *
+ * @param blk      The device.
+ * @param buf      Buffer of `count * SECTOR_SIZE` bytes.
+ * @param sector   First sector.
+ * @param count    Number of sectors.
+ * @param is_write Set to true to write, false to read.
+ * @return True if every request succeeded.
+ */
+bool read_write_disk_range(struct virtio_blk *blk, void *buf, unsigned sector, unsigned count, bool is_write);
+
+/**
+ * @brief Makes all completed writes durable.
+ *
+ * Sends `VIRTIO_BLK_T_FLUSH`, which empties the device's write cache. A
+ * device without `VIRTIO_BLK_F_FLUSH` has no write cache, so there is nothing
+ * to do.
+ *
+ * @param blk The device.
+ * @return True on success.
+ */
+bool blk_flush(struct virtio_blk *blk);
+
+/**
+ * @brief Tells the device that a range of sectors is no longer in use.
+ *
+ * The contents of discarded sectors are undefined afterwards. Discarding is a
+ * hint: without `VIRTIO_BLK_F_DISCARD` the call succeeds without doing anything.
+ * The range is not checked.
+ *
+ * @param blk    The device.
+ * @param sector First sector.
+ * @param count  Number of sectors.
+ * @return True on success.
+ */
+bool blk_discard(struct virtio_blk *blk, unsigned sector, unsigned count);
+
+/**
+ * @brief Sets a range of sectors to zero.
+ *
+ * Uses `VIRTIO_BLK_T_WRITE_ZEROES`, which transfers no data and lets the
+ * device deallocate the sectors if it reports it may. Only for devices with
+ * `VIRTIO_BLK_F_WRITE_ZEROES`; for the others the generic device has no
+ * `write_zeroes` operation, and `blkdev_write_zeroes()` writes zeroed pages
+ * instead. The range is not checked.
+ *
+ * @param blk    The device.
+ * @param sector First sector.
+ * @param count  Number of sectors.
+ * @return True on success.
+ */
+bool blk_write_zeroes(struct virtio_blk *blk, unsigned sector, unsigned count);
@@ -18,6 +18,7 @@
 // V - Valid:      Entry is valid (if not set, other bits are ignored)
 
 #define SATP_SV32 (1u << 31)  // Enable Sv32 virtual memory mode (set mode field in satp register)
+#define SATP_PPN_MASK 0x3fffff  // Physical page number of the root page table (ppn field in satp register)
 
 #define PAGE_V (1 << 0)  // Valid
 #define PAGE_R (1 << 1)  // Readable
@@ -55,3 +56,16 @@
  * @param flags Additional flags for the mapping (e.g., PAGE_R, PAGE_W, PAGE_X, PAGE_U).
  */
 void map_page(uint32_t *table1, uint32_t vaddr, paddr_t paddr, uint32_t flags);
+
+/**
+ * @brief Translates a virtual address through a two-level page table.
+ *
+ * Walks the same two levels as `map_page()` without modifying anything.
+ *
+ * @param table1 Pointer to the first-level page table.
+ * @param vaddr  Virtual address to translate.
+ * @param flags  Permission bits the mapping must have (e.g., PAGE_U | PAGE_W), or 0.
+ * @return The physical address `vaddr` maps to, or 0 if it is not mapped or
+ *         lacks one of `flags`.
+ */
+paddr_t virt_to_phys(uint32_t *table1, uint32_t vaddr, uint32_t flags);
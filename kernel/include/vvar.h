@@ -0,0 +1,37 @@
+#pragma once
+#include "types.h"
+#include "vdso.h"
+
+/**
+ * @brief Kernel address of the data page shared with all processes (see `vdso.h`).
+ */
+extern struct vdso_data *vvar;
+
+/**
+ * @brief Allocates the shared data page and publishes the time base.
+ *
+ * Must be called after `init_clock()` and before the first process is created.
+ */
+void init_vvar(void);
+
+/**
+ * @brief Maps the shared data page and a new per-process page into a process.
+ *
+ * Both pages are user-readable but not writable. The per-process page is freed
+ * with the page table; the shared page is not.
+ *
+ * @param page_table Root page table of the process.
+ * @param pid        Process ID published in the per-process page.
+ * @return Kernel address of the per-process page.
+ */
+struct vdso_proc *map_vvar(uint32_t *page_table, int32_t pid);
+
+/**
+ * @brief Increments a counter of `vvar->counters` under the sequence lock.
+ *
+ * Only the boot hart runs kernel code, with interrupts disabled, so there is
+ * never more than one writer.
+ *
+ * @param counter Pointer into `vvar->counters`.
+ */
+void vvar_count(uint64_t *counter);
@@ -0,0 +1,82 @@
+#pragma once
+#include "types.h"
+
+struct process;
+
+/**
+ * @struct wait_queue
+ * @brief A FIFO list of processes blocked on an event.
+ *
+ * An event source (console input, disk completion, ...) owns a wait queue.
+ * A process that needs the event calls `sleep_on()`, which takes it out of the
+ * runnable set. When the event happens, the source calls `wake_up()` and the
+ * waiting processes become runnable again.
+ *
+ * The queue is intrusive: it is linked through `process::wait_next`, so
+ * blocking never allocates memory.
+ *
+ * @note Callers must re-check their condition after `sleep_on()` returns; a
+ * wake-up only means that the event *may* have happened:
+ * @code
+ * while (rx_empty())
+ *     sleep_on(&console_wq);
+ * @endcode
+ *
+ * @note Kernel code runs with interrupts disabled, so no wake-up can be lost
+ * between checking the condition and calling `sleep_on()`.
+ */
+struct wait_queue {
+    struct process *head;  ///< First (longest waiting) process, or NULL if empty.
+    struct process *tail;  ///< Last process, or NULL if empty.
+};
+
+/**
+ * @brief Blocks the current process on a wait queue.
+ *
+ * Marks the current process as `PROC_BLOCKED`, appends it to `wq` and yields
+ * the CPU. The function returns once another part of the kernel has woken the
+ * process up with `wake_up()` or `wake_up_one()` and the scheduler has picked it again.
+ *
+ * @param wq The wait queue to sleep on.
+ */
+void sleep_on(struct wait_queue *wq);
+
+/**
+ * @brief Blocks the current process on a wait queue, but not past a deadline.
+ *
+ * Like `sleep_on()`, but a per-process timer makes the process runnable again
+ * (and takes it off `wq`) once the `time` CSR reaches `deadline`.
+ *
+ * @param wq       The wait queue to sleep on, or NULL to just sleep until the deadline.
+ * @param deadline Absolute time in `time` CSR ticks, or `TIMER_NEVER`.
+ * @return `true` if the process was woken up by `wake_up()` / `wake_up_one()`,
+ *         `false` if the deadline passed first (including when it already had).
+ *
+ * @example
+ * @code
+ * uint64_t deadline = get_time() + ms_to_ticks(500);
+ * while (rx_empty()) {
+ *     if (!sleep_on_timeout(&console_wq, deadline))
+ *         return -1;  // Timed out.
+ * }
+ * @endcode
+ */
+bool sleep_on_timeout(struct wait_queue *wq, uint64_t deadline);
+
+/**
+ * @brief Wakes up every process blocked on a wait queue.
+ *
+ * All waiters are made `PROC_RUNNABLE` and the queue is emptied. The caller
+ * keeps the CPU; woken processes run at their next turn in the scheduler.
+ *
+ * @param wq The wait queue to wake up.
+ */
+void wake_up(struct wait_queue *wq);
+
+/**
+ * @brief Wakes up the longest waiting process blocked on a wait queue.
+ *
+ * @param wq The wait queue to wake up.
+ * @return `true` if a process was woken up, `false` if the queue was empty.
+ */
+bool wake_up_one(struct wait_queue *wq);
@@ -0,0 +1,55 @@
+#pragma once
+#include "types.h"
+
+/**
+ * @struct work
+ * @brief A unit of work deferred to the kernel worker thread.
+ *
+ * Embedded (usually statically) by the subsystem that defers work. Queuing a
+ * work item that is already queued does nothing, so repeated requests such as
+ * "write the file system back" coalesce into a single run.
+ *
+ * @example
+ * @code
+ * void flush_fs_work(struct work *w) { flush_fs(); }
+ * struct work fs_flush_work = {.fn = flush_fs_work};
+ *
+ * queue_work(&fs_flush_work);  // Returns immediately.
+ * @endcode
+ */
+struct work {
+    void (*fn)(struct work *);  ///< Function run by the worker thread.
+    struct work *next;          ///< Next item in the queue.
+    bool pending;               ///< True while queued and not yet started.
+};
+
+/**
+ * @brief Starts the kernel worker thread.
+ *
+ * Work queued before this call is kept and runs once the worker is scheduled.
+ *
+ * @note Must be called after `init_idle_process()`.
+ */
+void init_workqueue(void);
+
+/**
+ * @brief Queues a work item for the kernel worker thread.
+ *
+ * The caller continues immediately; `w->fn` runs later, in the worker thread,
+ * in FIFO order with other queued work. Does nothing if `w` is already queued.
+ *
+ * @param w The work item; `fn` must be set.
+ * @return `true` if the item was queued, `false` if it already was.
+ */
+bool queue_work(struct work *w);
+
+/**
+ * @brief Waits until a work item has finished running.
+ *
+ * Returns immediately if `w` is neither queued nor running.
+ *
+ * @param w The work item.
+ *
+ * @note Must be called from a process, and never from the worker thread itself.
+ */
+void flush_work(struct work *w);
@@ -1,8 +1,13 @@
 #include "alloc.h"
 
+#include "arg.h"
 #include "lib.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "stat.h"
 #include "types.h"
 #include "utils.h"
+#include "workqueue.h"
 
 /**
  * @brief Symbols marking the boundaries of free RAM.
@@ -15,14 +20,200 @@
  */
 extern char __free_ram[], __free_ram_end[];
 
-paddr_t alloc_pages(uint32_t n) {
-    static paddr_t next_paddr = (paddr_t)__free_ram;
-    paddr_t paddr = next_paddr;
-    next_paddr += n * PAGE_SIZE;
+/**
+ * @struct page_cache
+ * @brief Hart-local stack of free pages in front of the global page pool.
+ *
+ * Only the owning hart ever reads or writes its cache, and each cache is aligned
+ * to a cache line so that neighbouring harts never share one.
+ */
+struct page_cache {
+    uint32_t count;                   ///< Number of pages currently in `pages`.
+    paddr_t pages[PAGE_CACHE_SIZE];   ///< Free pages, used as a LIFO stack (hot pages first).
+    struct pagestat stat;             ///< Hit/refill/drain counters of this hart.
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * @brief Page caches of all harts, indexed by hart ID.
+ */
+struct page_cache page_caches[HARTS_MAX];
+
+/**
+ * @brief Global page pool shared by all harts.
+ *
+ * - `next_paddr`: Start of the never-allocated part of free RAM.
+ * - `free_list`:  Singly linked list of freed pages. The first word of a free
+ *                 page holds the physical address of the next one (0 ends the list).
+ * - `pool_lock`:  Serializes access to both of the above.
+ */
+paddr_t next_paddr = (paddr_t)__free_ram;
+paddr_t free_list;
+struct spinlock pool_lock;
+
+/**
+ * @brief Takes one page from the global pool.
+ *
+ * Prefers recycled pages from the free list and falls back to the untouched
+ * part of free RAM. The caller must hold `pool_lock`.
+ *
+ * @return Physical address of the page.
+ */
+paddr_t pool_take_page(void) {
+    if (free_list) {
+        paddr_t paddr = free_list;
+        free_list = *(paddr_t *)paddr;
+        return paddr;
+    }
 
-    if (next_paddr > (paddr_t)__free_ram_end)
+    if (next_paddr + PAGE_SIZE > (paddr_t)__free_ram_end)
         PANIC("out of memory");
 
+    paddr_t paddr = next_paddr;
+    next_paddr += PAGE_SIZE;
+    return paddr;
+}
+
+/**
+ * @brief Moves a batch of pages from the global pool into a hart-local cache.
+ *
+ * @param pc Cache to refill; filled up to `PAGE_CACHE_LOW` pages.
+ */
+void page_cache_refill(struct page_cache *pc) {
+    acquire(&pool_lock);
+    while (pc->count < PAGE_CACHE_LOW)
+        pc->pages[pc->count++] = pool_take_page();
+    release(&pool_lock);
+    pc->stat.refills++;
+}
+
+/**
+ * @brief Moves a batch of pages from a hart-local cache back to the global pool.
+ *
+ * The coldest pages (bottom of the stack) are returned first, so the hart keeps
+ * the pages most likely to still be in its data cache.
+ *
+ * @param pc Cache to drain; drained down to `PAGE_CACHE_LOW` pages.
+ */
+void page_cache_drain(struct page_cache *pc) {
+    uint32_t n = pc->count - PAGE_CACHE_LOW;
+
+    acquire(&pool_lock);
+    for (uint32_t i = 0; i < n; i++) {
+        *(paddr_t *)pc->pages[i] = free_list;
+        free_list = pc->pages[i];
+    }
+    release(&pool_lock);
+
+    memcpy(pc->pages, &pc->pages[n], PAGE_CACHE_LOW * sizeof(paddr_t));
+    pc->count = PAGE_CACHE_LOW;
+    pc->stat.drains++;
+}
+
+/**
+ * @brief Takes one (not zeroed) page from the calling hart's page cache.
+ *
+ * @return Physical address of the page.
+ */
+paddr_t page_cache_alloc(void) {
+    // Fast path: pop a page from this hart's cache, no shared state touched.
+    struct page_cache *pc = &page_caches[cpu_id()];
+    pc->stat.allocs++;
+    if (pc->count == 0)
+        page_cache_refill(pc);
+    else
+        pc->stat.hits++;
+    return pc->pages[--pc->count];
+}
+
+/**
+ * @brief Pages zeroed ahead of time by the kernel worker thread.
+ *
+ * - `zeroed_pool`:  Stack of zeroed pages.
+ * - `zeroed_count`: Number of pages in `zeroed_pool`.
+ * - `zeroed_lock`:  Serializes access to both of the above.
+ */
+paddr_t zeroed_pool[ZEROED_POOL_SIZE];
+uint32_t zeroed_count;
+struct spinlock zeroed_lock;
+
+/**
+ * @brief Tops up the pool of pre-zeroed pages; runs on the kernel worker thread.
+ *
+ * @param w Unused.
+ */
+void zero_pages(struct work *w) {
+    (void)w;
+
+    while (zeroed_count < ZEROED_POOL_SIZE) {
+        paddr_t paddr = page_cache_alloc();
+        memset((void *)paddr, 0, PAGE_SIZE);
+
+        acquire(&zeroed_lock);
+        bool full = zeroed_count == ZEROED_POOL_SIZE;
+        if (!full)
+            zeroed_pool[zeroed_count++] = paddr;
+        release(&zeroed_lock);
+
+        if (full) {
+            free_pages(paddr, 1);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Deferred refill of the pre-zeroed page pool.
+ */
+struct work zero_work = {.fn = zero_pages};
+
+paddr_t alloc_pages(uint32_t n) {
+    paddr_t paddr;
+
+    if (n == 1) {
+        acquire(&zeroed_lock);
+        uint32_t count = zeroed_count;
+        if (count)
+            paddr = zeroed_pool[--zeroed_count];
+        release(&zeroed_lock);
+
+        if (count <= ZEROED_POOL_LOW)
+            queue_work(&zero_work);
+        if (count)
+            return paddr;
+
+        paddr = page_cache_alloc();
+    } else {
+        // Contiguous blocks come straight from the untouched part of free RAM.
+        acquire(&pool_lock);
+        paddr = next_paddr;
+        next_paddr += n * PAGE_SIZE;
+        if (next_paddr > (paddr_t)__free_ram_end)
+            PANIC("out of memory");
+        release(&pool_lock);
+    }
+
     memset((void *)paddr, 0, n * PAGE_SIZE);
     return paddr;
 }
+
+void free_pages(paddr_t paddr, uint32_t n) {
+    if (!is_aligned(paddr, PAGE_SIZE))
+        PANIC("free_pages: unaligned paddr: 0x%x", paddr);
+
+    struct page_cache *pc = &page_caches[cpu_id()];
+    for (uint32_t i = 0; i < n; i++) {
+        pc->pages[pc->count++] = paddr + i * PAGE_SIZE;
+        pc->stat.frees++;
+        if (pc->count > PAGE_CACHE_HIGH)
+            page_cache_drain(pc);
+    }
+}
+
+size_t page_cache_stats(struct pagestat *stats, size_t n) {
+    size_t hart;
+    for (hart = 0; hart < n && hart < HARTS_MAX; hart++) {
+        stats[hart] = page_caches[hart].stat;
+        stats[hart].cached = page_caches[hart].count;
+    }
+    return hart;
+}
@@ -0,0 +1,198 @@
+#include "blkdev.h"
+
+#include "alloc.h"
+#include "clock.h"
+#include "lib.h"
+#include "types.h"
+#include "utils.h"
+
+/**
+ * @brief Registered block devices, indexed by handle.
+ */
+struct blkdev *blkdevs[BLKDEV_MAX];
+unsigned blkdev_num;
+
+/**
+ * @brief A zeroed page for backends without `write_zeroes`, allocated on first use.
+ */
+paddr_t blkdev_zero_page;
+
+unsigned blkdev_register(struct blkdev *dev) {
+    if (blkdev_num == BLKDEV_MAX)
+        PANIC("blkdev: too many block devices");
+
+    dev->handle = blkdev_num;
+    blkdevs[blkdev_num++] = dev;
+    INFO("blkdev %d: %s, %d sectors, queue depth %d", dev->handle, dev->name, dev->capacity, dev->queue_depth);
+    return dev->handle;
+}
+
+struct blkdev *blkdev_get(unsigned handle) {
+    return handle < blkdev_num ? blkdevs[handle] : NULL;
+}
+
+unsigned blkdev_count(void) {
+    return blkdev_num;
+}
+
+/**
+ * @brief Checks that a range of sectors lies within a device.
+ *
+ * @param dev    The device.
+ * @param sector First sector.
+ * @param count  Number of sectors.
+ * @return True if all sectors exist.
+ */
+bool blkdev_check_range(struct blkdev *dev, unsigned sector, unsigned count) {
+    if (sector > dev->capacity || count > dev->capacity - sector) {
+        FAILED("%s: tried to access %d sectors at sector=%d, but capacity is %d", dev->name, count, sector,
+               dev->capacity);
+        return false;
+    }
+    return true;
+}
+
+void blkdev_request_start(struct blkdev *dev) {
+    struct blkdev_stats *stats = &dev->stats;
+    if (stats->inflight++ == 0)
+        stats->busy_since = get_time();
+    if (stats->inflight > stats->inflight_max)
+        stats->inflight_max = stats->inflight;
+}
+
+void blkdev_request_end(struct blkdev *dev) {
+    struct blkdev_stats *stats = &dev->stats;
+    if (--stats->inflight == 0)
+        stats->busy += get_time() - stats->busy_since;
+}
+
+bool blkdev_account(struct blkdev *dev, unsigned op, unsigned count, uint64_t start, bool ok) {
+    struct blkdev_stats *stats = &dev->stats;
+    uint64_t now = get_time();
+    if (!ok) {
+        stats->errors++;
+        return false;
+    }
+
+    stats->ops[op]++;
+    stats->sectors[op] += count;
+    stats->latency[op] += now - start;
+
+    // Bucket b holds latencies of b significant bits in microseconds.
+    uint64_t us = ticks_to_ns(now - start) / 1000;
+    unsigned bucket = 0;
+    while (us && bucket < IOSTAT_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    stats->histogram[op][bucket]++;
+    return true;
+}
+
+/**
+ * @brief Accounts for the start of an operation.
+ *
+ * A backend that does not report its own requests has one in flight per call.
+ *
+ * @param dev The device.
+ * @return The start time, for `blkdev_io_end()`.
+ */
+uint64_t blkdev_io_start(struct blkdev *dev) {
+    if (!dev->counts_requests)
+        blkdev_request_start(dev);
+    return get_time();
+}
+
+/**
+ * @brief Accounts for the end of an operation.
+ *
+ * @param dev   The device.
+ * @param op    `IOSTAT_READ`, `IOSTAT_WRITE` or `IOSTAT_FLUSH`.
+ * @param count Number of sectors transferred.
+ * @param start The value `blkdev_io_start()` returned.
+ * @param ok    Result of the operation.
+ * @return `ok`.
+ */
+bool blkdev_io_end(struct blkdev *dev, unsigned op, unsigned count, uint64_t start, bool ok) {
+    if (!dev->counts_requests)
+        blkdev_request_end(dev);
+    return blkdev_account(dev, op, count, start, ok);
+}
+
+bool blkdev_read(struct blkdev *dev, void *buf, unsigned sector, unsigned count) {
+    if (!blkdev_check_range(dev, sector, count))
+        return false;
+    uint64_t start = blkdev_io_start(dev);
+    return blkdev_io_end(dev, IOSTAT_READ, count, start, dev->ops->read(dev, buf, sector, count));
+}
+
+bool blkdev_write(struct blkdev *dev, const void *buf, unsigned sector, unsigned count) {
+    if (!blkdev_check_range(dev, sector, count))
+        return false;
+    uint64_t start = blkdev_io_start(dev);
+    return blkdev_io_end(dev, IOSTAT_WRITE, count, start, dev->ops->write(dev, buf, sector, count));
+}
+
+bool blkdev_flush(struct blkdev *dev) {
+    uint64_t start = blkdev_io_start(dev);
+    return blkdev_io_end(dev, IOSTAT_FLUSH, 0, start, dev->ops->flush ? dev->ops->flush(dev) : true);
+}
+
+bool blkdev_discard(struct blkdev *dev, unsigned sector, unsigned count) {
+    if (!blkdev_check_range(dev, sector, count))
+        return false;
+    return dev->ops->discard ? dev->ops->discard(dev, sector, count) : true;
+}
+
+bool blkdev_write_zeroes(struct blkdev *dev, unsigned sector, unsigned count) {
+    if (!blkdev_check_range(dev, sector, count))
+        return false;
+    if (dev->ops->write_zeroes)
+        return dev->ops->write_zeroes(dev, sector, count);
+
+    if (!blkdev_zero_page)
+        blkdev_zero_page = alloc_pages(1);
+
+    const unsigned per_page = PAGE_SIZE / SECTOR_SIZE;
+    while (count > 0) {
+        unsigned n = count < per_page ? count : per_page;
+        if (!dev->ops->write(dev, (const void *)blkdev_zero_page, sector, n))
+            return false;
+        sector += n;
+        count -= n;
+    }
+    return true;
+}
+
+size_t blkdev_iostat(struct iostat *stats, size_t n) {
+    uint64_t now = get_time();
+    size_t count = 0;
+    for (; count < blkdev_num && count < n; count++) {
+        struct blkdev *dev = blkdevs[count];
+        struct blkdev_stats *src = &dev->stats;
+        struct iostat *stat = &stats[count];
+
+        memset(stat->name, 0, sizeof(stat->name));
+        for (size_t i = 0; i < sizeof(stat->name) - 1 && dev->name[i]; i++)
+            stat->name[i] = dev->name[i];
+        stat->capacity = dev->capacity;
+        stat->errors = src->errors;
+        stat->inflight = src->inflight;
+        stat->inflight_max = src->inflight_max;
+
+        // Include the busy period in progress, if any.
+        uint64_t busy = src->busy;
+        if (src->inflight)
+            busy += now - src->busy_since;
+        stat->busy = ticks_to_ns(busy);
+
+        for (unsigned op = 0; op < IOSTAT_OPS; op++) {
+            stat->ops[op] = src->ops[op];
+            stat->sectors[op] = src->sectors[op];
+            stat->latency[op] = ticks_to_ns(src->latency[op]);
+            for (unsigned b = 0; b < IOSTAT_BUCKETS; b++)
+                stat->histogram[op][b] = src->histogram[op][b];
+        }
+    }
+    return count;
+}
@@ -0,0 +1,54 @@
+#include "clock.h"
+
+#include "fdt.h"
+#include "lib.h"
+#include "riscv.h"
+#include "types.h"
+#include "utils.h"
+
+uint32_t timebase_freq = TIMEBASE_FREQ_DEFAULT;
+
+void init_clock(void) {
+    INFO("Initializing clock...");
+
+    uint32_t len;
+    const void *freq = fdt_getprop("/cpus", "timebase-frequency", &len);
+    if (freq && len == sizeof(uint32_t) && fdt32(freq))
+        timebase_freq = fdt32(freq);
+    else
+        FAILED("clock: no timebase-frequency in device tree, assuming %d Hz", timebase_freq);
+
+    // Let user mode read cycle, time and instret directly (rdcycle/rdtime/rdinstret).
+    WRITE_CSR(scounteren, SCOUNTEREN_CY | SCOUNTEREN_TM | SCOUNTEREN_IR);
+
+    OK("Initialized clock: %d Hz.", timebase_freq);
+}
+
+uint64_t get_time(void) {
+    uint32_t hi, lo;
+    do {
+        hi = READ_CSR(timeh);
+        lo = READ_CSR(time);
+    } while (hi != READ_CSR(timeh));
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Both conversions split the value into whole seconds and a remainder so that
+// the intermediate products cannot overflow 64 bits.
+
+uint64_t ns_to_ticks(uint64_t ns) {
+    uint64_t sec = ns / NSEC_PER_SEC;
+    uint64_t rem = ns % NSEC_PER_SEC;
+    return sec * timebase_freq + (rem * timebase_freq + NSEC_PER_SEC - 1) / NSEC_PER_SEC;
+}
+
+uint64_t ticks_to_ns(uint64_t ticks) {
+    uint64_t sec = ticks / timebase_freq;
+    uint64_t rem = ticks % timebase_freq;
+    return sec * NSEC_PER_SEC + rem * NSEC_PER_SEC / timebase_freq;
+}
+
+uint64_t ms_to_ticks(uint64_t ms) {
+    return ms * timebase_freq / MSEC_PER_SEC;
+}
@@ -0,0 +1,148 @@
+#include "fdt.h"
+
+#include "arg.h"
+#include "lib.h"
+#include "str.h"
+#include "types.h"
+#include "utils.h"
+
+/** Maximum node depth of a lookup path. */
+#define FDT_PATH_MAX_DEPTH 8
+
+/**
+ * @brief The device tree blob, or NULL if none was found at boot.
+ */
+const struct fdt_header *fdt;
+
+uint32_t fdt32(const void *p) {
+    const uint8_t *b = (const uint8_t *)p;
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+void init_fdt(paddr_t dtb) {
+    const struct fdt_header *header = (const struct fdt_header *)dtb;
+    if (!dtb || fdt32(&header->magic) != FDT_MAGIC) {
+        FAILED("fdt: no device tree at 0x%x", dtb);
+        return;
+    }
+
+    fdt = header;
+    INFO("fdt: device tree at 0x%x, %d bytes", dtb, fdt32(&header->totalsize));
+}
+
+/**
+ * @brief Checks whether a node name matches one component of a lookup path.
+ *
+ * @param node The node name from the blob, e.g. `"virtio_mmio@10001000"`.
+ * @param comp The path component (not NUL-terminated).
+ * @param len  Length of the path component.
+ * @return `true` if the names are equal, or if `node` equals `comp` up to its unit address.
+ */
+bool fdt_name_matches(const char *node, const char *comp, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (node[i] != comp[i])
+            return false;
+    }
+    return node[len] == '\0' || node[len] == '@';
+}
+
+const void *fdt_getprop(const char *path, const char *name, uint32_t *len) {
+    if (!fdt)
+        return NULL;
+
+    // Split the path into components.
+    const char *comps[FDT_PATH_MAX_DEPTH];
+    size_t comp_lens[FDT_PATH_MAX_DEPTH];
+    int ncomps = 0;
+    for (const char *p = path; *p;) {
+        while (*p == '/') p++;
+        if (!*p)
+            break;
+        if (ncomps == FDT_PATH_MAX_DEPTH)
+            return NULL;
+        comps[ncomps] = p;
+        while (*p && *p != '/') p++;
+        comp_lens[ncomps] = p - comps[ncomps];
+        ncomps++;
+    }
+
+    const uint8_t *base = (const uint8_t *)fdt;
+    const char *strings = (const char *)base + fdt32(&fdt->off_dt_strings);
+    const uint8_t *p = base + fdt32(&fdt->off_dt_struct);
+
+    // depth:   depth of the current node (root = 0).
+    // matched: number of path components matched by the current node and its
+    //          ancestors. The current node is on the path iff matched == depth.
+    int depth = -1;
+    int matched = 0;
+    while (true) {
+        uint32_t token = fdt32(p);
+        p += 4;
+
+        switch (token) {
+            case FDT_BEGIN_NODE: {
+                const char *node_name = (const char *)p;
+                depth++;
+                if (depth > 0 && matched == depth - 1 && depth <= ncomps &&
+                    fdt_name_matches(node_name, comps[depth - 1], comp_lens[depth - 1]))
+                    matched = depth;
+                p += align_up(strlen((char *)node_name) + 1, 4);
+                break;
+            }
+            case FDT_END_NODE:
+                if (matched == depth && depth > 0) {
+                    // Leaving a node on the path; if it was the target, the property does not exist.
+                    if (depth == ncomps)
+                        return NULL;
+                    matched--;
+                }
+                depth--;
+                break;
+            case FDT_PROP: {
+                uint32_t prop_len = fdt32(p);
+                const char *prop_name = strings + fdt32(p + 4);
+                const void *value = p + 8;
+                p += 8 + align_up(prop_len, 4);
+
+                if (depth == ncomps && matched == ncomps && !strcmp(prop_name, name)) {
+                    if (len)
+                        *len = prop_len;
+                    return value;
+                }
+                break;
+            }
+            case FDT_NOP:
+                break;
+            case FDT_END:
+                return NULL;
+            default:
+                FAILED("fdt: unexpected token 0x%x", token);
+                return NULL;
+        }
+    }
+}
+
+const char *fdt_bootarg(const char *key, uint32_t *len) {
+    uint32_t args_len;
+    const char *args = fdt_getprop("/chosen", "bootargs", &args_len);
+
+    for (uint32_t i = 0; args && i < args_len && args[i];) {
+        uint32_t end = i;
+        while (end < args_len && args[end] && args[end] != ' ')
+            end++;
+
+        uint32_t k = 0;
+        while (key[k] && i + k < end && args[i + k] == key[k])
+            k++;
+        if (!key[k] && i + k < end && args[i + k] == '=') {
+            *len = end - i - k - 1;
+            return &args[i + k + 1];
+        }
+
+        i = end;
+        while (i < args_len && args[i] == ' ')
+            i++;
+    }
+
+    return NULL;
+}
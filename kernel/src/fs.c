@@ -1,11 +1,13 @@
 #include "fs.h"
 
 #include "arg.h"
+#include "fdt.h"
 #include "lib.h"
+#include "ramdisk.h"
 #include "str.h"
 #include "types.h"
 #include "utils.h"
-#include "virtio_disk.h"
+#include "workqueue.h"
 
 // Global array of in-memory file structures.
 // Used to simulate a simple filesystem with a limited number of files.
@@ -16,6 +18,14 @@ struct file files[FILES_MAX];
 // This represents a basic disk abstraction used for read/write operations.
 uint8_t disk[DISK_MAX_SIZE];
 
+// The block device holding the archive: the primary disk, or the RAM disk
+// with the kernel argument "fs=ram".
+struct blkdev *fs_dev;
+
+// Number of sectors at the start of the disk that may hold archive data,
+// including the end-of-archive blocks. Sectors past it are free.
+unsigned disk_used_sectors;
+
 struct file *fs_lookup(const char *filename) {
     for (size_t i = 0; i < FILES_MAX; i++) {
         struct file *file = &files[i];
@@ -29,9 +39,17 @@ struct file *fs_lookup(const char *filename) {
 void init_fs(void) {
     INFO("Initializing file system...");
 
-    // Step 1: Read disk sectors into memory buffer
-    for (unsigned sector = 0; sector < sizeof(disk) / SECTOR_SIZE; sector++)
-        read_write_disk(&disk[sector * SECTOR_SIZE], sector, false);
+    // Step 1: Pick the device and read its sectors into memory buffer
+    uint32_t len;
+    const char *backend = fdt_bootarg("fs", &len);
+    if (backend && len == 3 && backend[0] == 'r' && backend[1] == 'a' && backend[2] == 'm')
+        fs_dev = ramdisk_get();
+    if (!fs_dev)
+        fs_dev = blkdev_get(0);
+    if (!fs_dev)
+        PANIC("fs: no block device");
+    INFO("fs: using %s", fs_dev->name);
+    blkdev_read(fs_dev, disk, 0, sizeof(disk) / SECTOR_SIZE);
 
     // Step 2: Start parsing TAR archive format
     unsigned off = 0;
@@ -66,6 +84,10 @@ void init_fs(void) {
                                                                            // skip tar header + data size aligned with SECTOR_SIZE
     }
 
+    // Whatever the image holds past the parsed files, the first flush
+    // overwrites or discards it like any other stale data.
+    disk_used_sectors = sizeof(disk) / SECTOR_SIZE;
+
     OK("Initialized file system.");
 }
 
@@ -123,9 +145,48 @@ void flush_fs(void) {
         off += align_up(sizeof(struct tar_header) + file->size, SECTOR_SIZE);
     }
 
-    // Step 3: Write the updated disk buffer to the virtual block device
-    for (unsigned sector = 0; sector < sizeof(disk) / SECTOR_SIZE; sector++)
-        read_write_disk(&disk[sector * SECTOR_SIZE], sector, true);
+    // Step 3: Write the archive itself to the block device
+    unsigned end = off / SECTOR_SIZE;
+    if (end)
+        blkdev_write(fs_dev, disk, 0, end);
+
+    // Step 4: Terminate it with two zero blocks, without sending zeros over the queue
+    unsigned zero_end = end + 2;
+    if (zero_end > fs_dev->capacity)
+        zero_end = fs_dev->capacity;
+    if (zero_end > end)
+        blkdev_write_zeroes(fs_dev, end, zero_end - end);
+
+    // Step 5: Let the device reclaim what the previous archive used beyond the new end
+    if (disk_used_sectors > zero_end)
+        blkdev_discard(fs_dev, zero_end, disk_used_sectors - zero_end);
+    disk_used_sectors = zero_end;
+
+    // Step 6: Make the new archive durable
+    blkdev_flush(fs_dev);
+
+    INFO("Wrote %d bytes to disk.", off);
+}
+
+/**
+ * @brief Runs `flush_fs()` on the kernel worker thread.
+ *
+ * @param w Unused.
+ */
+void flush_fs_work(struct work *w) {
+    (void)w;
+    flush_fs();
+}
+
+/**
+ * @brief Deferred write-back of the file system.
+ */
+struct work fs_flush_work = {.fn = flush_fs_work};
+
+void flush_fs_async(void) {
+    queue_work(&fs_flush_work);
+}
 
-    INFO("Wrote %d bytes to disk.", sizeof(disk));
+void sync_fs(void) {
+    flush_work(&fs_flush_work);
 }
@@ -1,13 +1,22 @@
 #include "alloc.h"
+#include "clock.h"
+#include "fdt.h"
 #include "fs.h"
 #include "lib.h"
+#include "plic.h"
 #include "proc.h"
+#include "ramdisk.h"
 #include "riscv.h"
+#include "stripe.h"
+#include "timer.h"
 #include "trampoline.h"
 #include "types.h"
+#include "uart.h"
 #include "user.h"
 #include "utils.h"
 #include "virtio_disk.h"
+#include "vvar.h"
+#include "workqueue.h"
 
 /**
  * @brief Linker-defined symbols for memory section boundaries.
@@ -78,21 +87,40 @@ void init_trap_handler(void) {
  *
  * - Logs the boot message.
  * - Clears the BSS segment via `init_bss()`.
+ * - Locates the device tree with `init_fdt()` and calibrates the clock from it
+ *   with `init_clock()`.
  * - Sets up the trap/interrupt handler with `init_trap_handler()`.
- * - Initializes the VirtIO block device using `init_virtio_blk()`.
- * - Creates the idle process with `init_idle_process()`.
+ * - Initializes the interrupt controller, the timer and the console UART via
+ *   `init_plic()`, `init_timer()` and `init_uart()`.
+ * - Finds and initializes the VirtIO block devices using `init_virtio_blk()`, and
+ *   stripes the scratch disks with `init_stripe()`.
+ * - Allocates the data page shared read-only with user processes with `init_vvar()`.
+ * - Creates the idle process with `init_idle_process()`, then sets up the RAM disk,
+ *   if the command line asks for one, with `init_ramdisk()`.
  * - Creates the initial user process via `init_user()`.
+ * - Starts the kernel worker thread for deferred work with `init_workqueue()`.
  * - Initializes the filesystem with `init_fs()`.
  *
  * Finally, it logs a success message indicating that the system has booted.
+ *
+ * @param dtb Physical address of the device tree blob passed by OpenSBI.
  */
-void init_boot(void) {
+void init_boot(paddr_t dtb) {
     INFO("Booting...");
     init_bss();
+    init_fdt(dtb);
+    init_clock();
     init_trap_handler();
+    init_plic();
+    init_timer();
+    init_uart();
     init_virtio_blk();
+    init_stripe();
+    init_vvar();
     init_idle_process();
+    init_ramdisk();
     init_user();
+    init_workqueue();
     init_fs();
     OK("Booted successfully.");
 }
@@ -106,22 +134,20 @@ void init_boot(void) {
  * Steps performed:
  * - Calls `init_boot()` to initialize all subsystems.
  * - Logs a message indicating transition to the user shell.
- * - Calls `yield()` to switch context to the first user or idle process.
- * - Triggers a panic if control returns unexpectedly after yielding.
- * - Enters an infinite low-power wait loop (`wfi`) as a fallback.
+ * - Becomes the idle process via `idle()`, which switches to the first user
+ *   process and parks the hart in `wfi` whenever nothing is runnable.
+ *
+ * @param hartid ID of the boot hart, passed by OpenSBI in `a0`.
+ * @param dtb    Physical address of the device tree blob, passed by OpenSBI in `a1`.
  *
  * @note This function should never return under normal operation.
  */
-void kernel_main(void) {
-    init_boot();
+void kernel_main(uint32_t hartid, paddr_t dtb) {
+    init_boot(dtb);
+    INFO("Boot hart: %d", hartid);
 
     INFO("Switching to user shell...");
-    yield();
-    PANIC("switched to idle process");
-
-    for (;;) {
-        __asm__ __volatile__("wfi");
-    };  // loop infinitely
+    idle();
 }
 
 __attribute__((section(".text.boot"))) __attribute__((naked))
@@ -137,7 +163,13 @@ __attribute__((section(".text.boot"))) __attribute__((naked))
  * flow.
  *
  * @details
- * - The `mv sp, %[stack_top]` instruction initializes the stack pointer.
+ * - The `mv tp, a0` instruction keeps the hart ID that OpenSBI passes in `a0`
+ * in the thread pointer, where `cpu_id()` reads it from. `a0` and the device
+ * tree address in `a1` are left untouched and become the arguments of `kernel_main()`.
+ * - The `la sp, __stack_top` instruction initializes the stack pointer. The
+ * address is loaded inside the assembly block (not through an input operand)
+ * so that the compiler cannot pick `a0` as a scratch register and clobber the
+ * hart ID before it has been saved.
  * - The `j kernel_main` instruction transfers control to the kernel's main
  * function.
  * - The `__stack_top` symbol is provided by the linker script and represents
@@ -146,10 +178,8 @@ __attribute__((section(".text.boot"))) __attribute__((naked))
 void
 boot(void) {
     __asm__ __volatile__(
-        "mv sp, %[stack_top]\n"  // Set the stack pointer
-        "j kernel_main\n"        // Jump to the kernel main function
-        :
-        : [stack_top] "r"(
-            __stack_top)  // Pass the stack top address as %[stack_top]
+        "mv tp, a0\n"             // Keep the hart ID for cpu_id()
+        "la sp, __stack_top\n"    // Set the stack pointer
+        "j kernel_main\n"         // Jump to the kernel main function
     );
 }
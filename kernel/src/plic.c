@@ -0,0 +1,37 @@
+#include "plic.h"
+
+#include "lib.h"
+#include "riscv.h"
+#include "types.h"
+#include "vm.h"
+
+void init_plic(void) {
+    *(volatile uint32_t *)PLIC_STHRESHOLD(cpu_id()) = 0;
+    WRITE_CSR(sie, READ_CSR(sie) | SIE_SEIE);
+}
+
+void plic_enable(uint32_t irq, uint32_t priority) {
+    volatile uint32_t *senable = (volatile uint32_t *)PLIC_SENABLE(cpu_id());
+    *(volatile uint32_t *)PLIC_PRIORITY(irq) = priority;
+    senable[irq / 32] |= 1u << (irq % 32);
+}
+
+uint32_t plic_claim(void) {
+    return *(volatile uint32_t *)PLIC_SCLAIM(cpu_id());
+}
+
+void plic_complete(uint32_t irq) {
+    *(volatile uint32_t *)PLIC_SCLAIM(cpu_id()) = irq;
+}
+
+void map_plic(uint32_t *page_table) {
+    // Priorities and the enable bits of all supervisor contexts.
+    map_page(page_table, PLIC_PADDR, PLIC_PADDR, PAGE_R | PAGE_W);
+    map_page(page_table, PLIC_PADDR + 0x2000, PLIC_PADDR + 0x2000, PAGE_R | PAGE_W);
+
+    // Threshold and claim/complete registers, one page per supervisor context.
+    for (uint32_t hart = 0; hart < HARTS_MAX; hart++) {
+        paddr_t paddr = PLIC_STHRESHOLD(hart);
+        map_page(page_table, paddr, paddr, PAGE_R | PAGE_W);
+    }
+}
@@ -1,11 +1,24 @@
 #include "proc.h"
 
 #include "alloc.h"
+#include "arg.h"
+#include "clock.h"
+#include "errno.h"
 #include "lib.h"
+#include "plic.h"
+#include "riscv.h"
+#include "ring.h"
+#include "stat.h"
+#include "timer.h"
+#include "trampoline.h"
 #include "types.h"
+#include "uart.h"
 #include "utils.h"
 #include "virtio_disk.h"
 #include "vm.h"
+#include "vvar.h"
+#include "wait.h"
+#include "workqueue.h"
 
 extern char __kernel_base[], __free_ram_end[];
 
@@ -90,7 +103,19 @@ switch_context(uint32_t *prev_sp,
         "ret\n");  // Return to the instruction after previous call (restored ra)
 }
 
-struct process *create_process(const void *image, size_t image_size, const vaddr_t base_addr, const vaddr_t pc) {
+/**
+ * @brief Reserves a process slot and prepares its kernel stack.
+ *
+ * Performs the steps shared by user processes and kernel threads: finds an
+ * unused slot, clears whatever its previous owner left in it (accounting,
+ * wait state, rings) and builds the initial `switch_context()` frame, so that
+ * the first switch to the process "returns" to `entry`.
+ *
+ * @param entry Address the first context switch jumps to.
+ * @return The slot, with `pid` and `sp` set but still `PROC_UNUSED`, or NULL
+ *         if all slots are in use.
+ */
+struct process *alloc_process(vaddr_t entry) {
     // Step 1: Find an unused process slot
     struct process *proc = NULL;
     int i;
@@ -102,7 +127,8 @@ struct process *create_process(const void *image, size_t image_size, const vaddr
     }
 
     if (!proc)
-        PANIC("no free process slots");
+        return NULL;
+    memset(proc, 0, offsetof(struct process, stack));
 
     // Step 2: Initialize the kernel stack for first-time context switching
     // Stack callee-saved registers. These register values will be restored in
@@ -121,7 +147,17 @@ struct process *create_process(const void *image, size_t image_size, const vaddr
     *--sp = 0;                                                     // s2
     *--sp = 0;                                                     // s1
     *--sp = 0;                                                     // s0
-    *--sp = (uint32_t)pc;                                          // ra
+    *--sp = (uint32_t)entry;                                       // ra
+
+    proc->pid = i + 1;        // Assign a unique process ID (1-based)
+    proc->sp = (uint32_t)sp;  // Set initial kernel stack pointer
+    return proc;
+}
+
+struct process *create_process(const void *image, size_t image_size, const vaddr_t base_addr, const vaddr_t pc) {
+    struct process *proc = alloc_process(pc);
+    if (!proc)
+        return NULL;
 
     // Step 3: Create a new page table and map kernel memory (shared with all processes)
     uint32_t *page_table = (uint32_t *)alloc_pages(1);
@@ -143,27 +179,174 @@ struct process *create_process(const void *image, size_t image_size, const vaddr
                  PAGE_U | PAGE_R | PAGE_W | PAGE_X);
     }
 
-    // Step 5: Map hardware (virtio block device) into the process’s address space
-    // This allows the process to interact with disk I/O through memory-mapped registers.
-    map_page(page_table, VIRTIO_BLK_PADDR, VIRTIO_BLK_PADDR, PAGE_R | PAGE_W);
+    // Step 5: Map hardware (virtio-mmio slots, UART, PLIC) into the process’s address space
+    // This allows the kernel to do disk I/O and handle interrupts while running on this page table.
+    for (unsigned slot = 0; slot < VIRTIO_MMIO_SLOTS; slot++)
+        map_page(page_table, VIRTIO_MMIO_PADDR(slot), VIRTIO_MMIO_PADDR(slot), PAGE_R | PAGE_W);
+    map_page(page_table, UART0_PADDR, UART0_PADDR, PAGE_R | PAGE_W);
+    map_plic(page_table);
 
-    // Step 6: Finalize the process struct
-    proc->pid = i + 1;            // Assign a unique process ID (1-based)
-    proc->state = PROC_RUNNABLE;  // Mark as ready to be scheduled
-    proc->sp = (uint32_t)sp;      // Set initial kernel stack pointer
+    // Step 6: Map the read-only kernel data pages (clock, pid, counters), see vdso.h
+    proc->vdso = map_vvar(page_table, proc->pid);
+
+    // Step 7: Finalize the process struct
     proc->page_table = page_table;
+    proc->parent = NULL;
+    proc->state = PROC_RUNNABLE;  // Mark as ready to be scheduled
     return proc;
 }
 
+/**
+ * @brief First code run by a kernel thread.
+ *
+ * Reached through the initial `ra` set up by `alloc_process()`.
+ */
+void kthread_entry(void) {
+    current_proc->kthread_fn(current_proc->kthread_arg);
+    exit_process();
+}
+
+struct process *create_kthread(void (*fn)(void *), void *arg) {
+    struct process *proc = alloc_process((vaddr_t)kthread_entry);
+    if (!proc)
+        PANIC("no free process slots");
+
+    proc->page_table = NULL;
+    proc->vdso = NULL;
+    proc->parent = NULL;
+    proc->kthread_fn = fn;
+    proc->kthread_arg = arg;
+    proc->state = PROC_RUNNABLE;
+    return proc;
+}
+
+/**
+ * @brief Frees a page table and every user page mapped through it.
+ *
+ * Kernel and MMIO mappings and the shared vDSO data page are shared by all page
+ * tables and are left alone.
+ *
+ * @param table1 Root (level 1) page table.
+ */
+void free_page_table(uint32_t *table1) {
+    for (uint32_t vpn1 = 0; vpn1 < PAGE_SIZE / sizeof(uint32_t); vpn1++) {
+        if (!(table1[vpn1] & PAGE_V))
+            continue;
+
+        uint32_t *table0 = (uint32_t *)((table1[vpn1] >> 10) * PAGE_SIZE);
+        for (uint32_t vpn0 = 0; vpn0 < PAGE_SIZE / sizeof(uint32_t); vpn0++) {
+            paddr_t paddr = (table0[vpn0] >> 10) * PAGE_SIZE;
+            if ((table0[vpn0] & (PAGE_V | PAGE_U)) == (PAGE_V | PAGE_U) && paddr != (paddr_t)vvar)
+                free_pages(paddr, 1);
+        }
+        free_pages((paddr_t)table0, 1);
+    }
+    free_pages((paddr_t)table1, 1);
+}
+
+/**
+ * @brief Reclaims the memory and slots of all exited processes.
+ *
+ * Runs on the kernel worker thread. An exited process is never the one running,
+ * and `yield()` never leaves an exited process's page table loaded for a kernel
+ * thread, so its memory is safe to free. The slot (and with it the pid) of a
+ * child stays `PROC_EXITED` until its parent has collected it with
+ * `wait_child()` or has exited itself; only then is it freed.
+ *
+ * @param w Unused.
+ */
+void reap_processes(struct work *w) {
+    (void)w;
+
+    for (size_t i = 0; i < PROCS_MAX; i++) {
+        struct process *proc = &procs[i];
+        if (proc->state != PROC_EXITED)
+            continue;
+
+        if (proc->page_table)
+            free_page_table(proc->page_table);
+        proc->page_table = NULL;
+        proc->vdso = NULL;
+        proc->kthread_fn = NULL;
+        if (!proc->parent)
+            proc->state = PROC_UNUSED;
+    }
+}
+
+/**
+ * @brief Deferred reclamation of exited processes.
+ */
+struct work reap_work = {.fn = reap_processes};
+
+void exit_process(void) {
+    ring_release(current_proc);
+
+    // Orphans have nobody to wait for them: the reaper frees those that have
+    // exited already, and the others as soon as they exit.
+    for (size_t i = 0; i < PROCS_MAX; i++) {
+        if (procs[i].parent == current_proc)
+            procs[i].parent = NULL;
+    }
+
+    current_proc->state = PROC_EXITED;
+    if (current_proc->parent)
+        wake_up(&current_proc->parent->child_wait);
+    queue_work(&reap_work);
+    yield();
+    PANIC("unreachable");
+}
+
+int32_t wait_child(int32_t pid) {
+    if (pid < 1 || pid > PROCS_MAX)
+        return -ECHILD;
+
+    // The slot stays the child's until we collect it below.
+    struct process *child = &procs[pid - 1];
+    if (child->parent != current_proc || child->state == PROC_UNUSED)
+        return -ECHILD;
+
+    while (child->state != PROC_EXITED)
+        sleep_on(&current_proc->child_wait);
+
+    // Collected: let the reaper free the slot.
+    child->parent = NULL;
+    queue_work(&reap_work);
+    return 0;
+}
+
 void init_idle_process() {
     INFO("Initializing idle process...")
-    struct process *idle_proc = create_process(NULL, 0, 0, (uint32_t)NULL);
+    idle_proc = create_process(NULL, 0, 0, (uint32_t)NULL);
     idle_proc->pid = 0;
     current_proc = idle_proc;
     OK("Initialized idle process.")
 };
 
-void yield(void) {
+void idle(void) {
+    for (;;) {
+        // Run everything that is runnable; returns once nothing else is.
+        yield();
+
+        // Program the earliest pending timer (or nothing at all), then sleep
+        // until an interrupt becomes pending and service it here.
+        // wfi also returns for interrupts masked by sstatus.SIE.
+        timer_reprogram();
+        __asm__ __volatile__("wfi");
+
+        uint32_t pending = READ_CSR(sip);
+        if (pending & SIE_STIE)
+            handle_interrupt(IRQ_S_TIMER);
+        if (pending & SIE_SEIE)
+            handle_interrupt(IRQ_S_EXT);
+    }
+}
+
+/**
+ * @brief Switches to the next runnable process, if any.
+ *
+ * @param involuntary True if the current process is being preempted.
+ */
+void schedule(bool involuntary) {
     // Search for a runnable process
     struct process *next = idle_proc;  // Default to idle process
     for (size_t i = 0; i < PROCS_MAX; i++) {
@@ -195,21 +378,101 @@ void yield(void) {
     //
     // 4. Set `sscratch` to point to the top of the new process's kernel stack.
     //    This register will be used during a trap to restore the correct stack pointer.
+    //    The word right above the stack (`hartid`) tells the trap handler which hart it runs on.
+    //
+    // Kernel threads have no page table of their own and keep the current one,
+    // which maps the kernel like every page table, so steps 1-3 are skipped.
+    // The exception is an exited process's page table, which is about to be
+    // freed: switch to the idle process's one instead.
+    next->hartid = cpu_id();
+    uint32_t *page_table = next->page_table;
+    if (!page_table && current_proc->state == PROC_EXITED)
+        page_table = idle_proc->page_table;
+
+    if (page_table) {
+        __asm__ __volatile__(
+            "sfence.vma\n"          // Step 1: Invalidate old TLB entries
+            "csrw satp, %[satp]\n"  // Step 2: Switch to the new page table
+            "sfence.vma\n"          // Step 3: Ensure changes take effect
+            :
+            : [satp] "r"(SATP_SV32 | ((uint32_t)page_table / PAGE_SIZE)));
+    }
     __asm__ __volatile__(
-        "sfence.vma\n"                  // Step 1: Invalidate old TLB entries
-        "csrw satp, %[satp]\n"          // Step 2: Switch to the new page table
-        "sfence.vma\n"                  // Step 3: Ensure changes take effect
         "csrw sscratch, %[sscratch]\n"  // Step 4: Set up kernel stack for trap handling
         :
-        : [satp] "r"(SATP_SV32 | ((uint32_t)next->page_table / PAGE_SIZE)),
-          [sscratch] "r"((uint32_t)&next->stack[sizeof(next->stack)]));
+        : [sscratch] "r"((uint32_t)&next->stack[sizeof(next->stack)]));
 
-    // Perform context switch to the selected process
+    // Charge the outgoing process and start the clock of the incoming one.
     struct process *prev = current_proc;
+    uint64_t now = get_time();
+    prev->stime += now - prev->acct_stamp;
+    next->acct_stamp = now;
+    if (involuntary)
+        prev->nivcsw++;
+    else
+        prev->nvcsw++;
+
+    vvar_count(&vvar->counters.context_switches);
+
+    // Perform context switch to the selected process
     current_proc = next;
+    timer_new_slice();
     switch_context(&prev->sp, &next->sp);
 }
 
+void yield(void) {
+    schedule(false);
+}
+
+void preempt(void) {
+    schedule(true);
+}
+
+void account_trap_enter(void) {
+    uint64_t now = get_time();
+    current_proc->utime += now - current_proc->acct_stamp;
+    current_proc->acct_stamp = now;
+}
+
+void account_trap_exit(void) {
+    uint64_t now = get_time();
+    current_proc->stime += now - current_proc->acct_stamp;
+    current_proc->acct_stamp = now;
+}
+
+size_t proc_stats(struct procstat *stats, size_t n) {
+    size_t count = 0;
+    for (size_t i = 0; i < PROCS_MAX && count < n; i++) {
+        struct process *proc = &procs[i];
+        if (proc->state == PROC_UNUSED)
+            continue;
+
+        // Include the running time of the caller up to now.
+        uint64_t stime = proc->stime;
+        if (proc == current_proc)
+            stime += get_time() - proc->acct_stamp;
+
+        struct procstat *stat = &stats[count++];
+        stat->pid = proc->pid;
+        stat->state = proc->state;
+        stat->kernel = !proc->page_table || proc == idle_proc;
+        stat->utime = ticks_to_ns(proc->utime);
+        stat->stime = ticks_to_ns(stime);
+        stat->nvcsw = proc->nvcsw;
+        stat->nivcsw = proc->nivcsw;
+    }
+    return count;
+}
+
+size_t nr_runnable(void) {
+    size_t n = 0;
+    for (size_t i = 0; i < PROCS_MAX; i++) {
+        if (procs[i].state == PROC_RUNNABLE && procs[i].pid > 0)
+            n++;
+    }
+    return n;
+}
+
 struct process *get_current_process(void) {
     return current_proc;
 }
@@ -0,0 +1,76 @@
+#include "ramdisk.h"
+
+#include "alloc.h"
+#include "fdt.h"
+#include "lib.h"
+#include "types.h"
+#include "utils.h"
+
+/**
+ * @brief The RAM disk, set up by `init_ramdisk()`.
+ */
+struct ramdisk ramdisk;
+
+/**
+ * @brief `blkdev_ops` of the RAM disk; `priv` is the `struct ramdisk`.
+ */
+bool ramdisk_read(struct blkdev *dev, void *buf, unsigned sector, unsigned count) {
+    struct ramdisk *rd = dev->priv;
+    memcpy(buf, &rd->data[sector * SECTOR_SIZE], count * SECTOR_SIZE);
+    return true;
+}
+
+bool ramdisk_write(struct blkdev *dev, const void *buf, unsigned sector, unsigned count) {
+    struct ramdisk *rd = dev->priv;
+    memcpy(&rd->data[sector * SECTOR_SIZE], buf, count * SECTOR_SIZE);
+    return true;
+}
+
+bool ramdisk_write_zeroes(struct blkdev *dev, unsigned sector, unsigned count) {
+    struct ramdisk *rd = dev->priv;
+    memset(&rd->data[sector * SECTOR_SIZE], 0, count * SECTOR_SIZE);
+    return true;
+}
+
+// Memory is always durable enough and discarded sectors may keep their data,
+// so flush and discard have nothing to do.
+const struct blkdev_ops ramdisk_ops = {
+    .read = ramdisk_read,
+    .write = ramdisk_write,
+    .flush = NULL,
+    .discard = NULL,
+    .write_zeroes = ramdisk_write_zeroes,
+};
+
+void init_ramdisk(void) {
+    // The value ends at a space or at the end of the command line, where atoi() stops.
+    uint32_t len;
+    const char *arg = fdt_bootarg("ramdisk", &len);
+    int32_t pages = arg ? atoi(arg) : 0;
+    if (pages <= 0)
+        return;
+
+    INFO("Initializing RAM disk...");
+    ramdisk.data = (uint8_t *)alloc_pages(pages);
+    ramdisk.sectors = pages * (PAGE_SIZE / SECTOR_SIZE);
+
+    // Start from the primary disk, as far as both reach.
+    struct blkdev *src = blkdev_get(0);
+    if (src) {
+        unsigned n = src->capacity < ramdisk.sectors ? src->capacity : ramdisk.sectors;
+        if (!blkdev_read(src, ramdisk.data, 0, n))
+            FAILED("RAM disk: could not copy %d sectors from %s", n, src->name);
+    }
+
+    ramdisk.dev.name = "ram0";
+    ramdisk.dev.ops = &ramdisk_ops;
+    ramdisk.dev.priv = &ramdisk;
+    ramdisk.dev.capacity = ramdisk.sectors;
+    ramdisk.dev.queue_depth = 1;
+    blkdev_register(&ramdisk.dev);
+    OK("Initialized RAM disk: %d sectors.", ramdisk.sectors);
+}
+
+struct blkdev *ramdisk_get(void) {
+    return ramdisk.data ? &ramdisk.dev : NULL;
+}
@@ -0,0 +1,176 @@
+#include "ring.h"
+
+#include "alloc.h"
+#include "clock.h"
+#include "errno.h"
+#include "ioring.h"
+#include "lib.h"
+#include "proc.h"
+#include "sbi.h"
+#include "sys.h"
+#include "syscall.h"
+#include "timer.h"
+#include "types.h"
+#include "uart.h"
+#include "vm.h"
+#include "wait.h"
+
+_Static_assert(sizeof(struct ioring) <= PAGE_SIZE, "the shared rings must fit in one page");
+
+int32_t ring_setup(void) {
+    struct process *proc = get_current_process();
+    if (proc->ring.shared)
+        return -EBUSY;
+
+    // Zeroed, so both rings start out empty. The kernel reaches the page
+    // through its identity mapping, the process at RING_VADDR.
+    paddr_t page = alloc_pages(1);
+    map_page(proc->page_table, RING_VADDR, page, PAGE_U | PAGE_R | PAGE_W);
+    proc->ring.shared = (struct ioring *)page;
+    return RING_VADDR;
+}
+
+/**
+ * @brief Posts a completion to the completion queue.
+ *
+ * `ring_enter()` never has more operations in flight than there is room for,
+ * so the queue cannot overflow.
+ *
+ * @param ring      The ring.
+ * @param user_data `user_data` of the submission.
+ * @param res       Result of the operation.
+ */
+void ring_complete(struct ring_state *ring, uint32_t user_data, int32_t res) {
+    struct ioring *r = ring->shared;
+    struct ring_cqe *cqe = &r->cqes[r->cq_tail & RING_MASK];
+    cqe->user_data = user_data;
+    cqe->res = res;
+    __sync_synchronize();  // Publish the entry before the new tail.
+    r->cq_tail++;
+    ring->inflight--;
+}
+
+/**
+ * @brief Timer callback completing a `RING_OP_TIMEOUT`.
+ *
+ * @param t The `timer` of a `struct ring_timeout`.
+ */
+void ring_timeout_expired(struct timer *t) {
+    struct process *proc = (struct process *)t->arg;
+    struct ring_timeout *timeout = (struct ring_timeout *)t;
+
+    ring_complete(&proc->ring, timeout->user_data, 0);
+    wake_up(&proc->ring.wait);
+}
+
+/**
+ * @brief Arms a `RING_OP_TIMEOUT`.
+ *
+ * @param proc The submitting process.
+ * @param sqe  The submission.
+ * @return True if the timeout is pending; false if it completed right away
+ *         (`*res` holds the result then).
+ */
+bool ring_arm_timeout(struct process *proc, const struct ring_sqe *sqe, int32_t *res) {
+    struct ring_timeout *timeout = NULL;
+    for (size_t i = 0; i < RING_TIMEOUTS_MAX; i++) {
+        if (!proc->ring.timeouts[i].timer.pending) {
+            timeout = &proc->ring.timeouts[i];
+            break;
+        }
+    }
+
+    if (!timeout) {
+        *res = -EAGAIN;
+        return false;
+    }
+
+    uint64_t ticks = ns_to_ticks(*(const uint64_t *)sqe->addr);
+    uint64_t deadline = (sqe->flags & TIMER_ABSTIME) ? ticks : get_time() + ticks;
+    if (deadline <= get_time()) {
+        *res = 0;
+        return false;
+    }
+
+    timeout->user_data = sqe->user_data;
+    timeout->timer.callback = ring_timeout_expired;
+    timeout->timer.arg = proc;
+    timer_add(&timeout->timer, deadline);
+    return true;
+}
+
+/**
+ * @brief Executes one submission.
+ *
+ * @param proc The submitting process.
+ * @param sqe  The submission.
+ * @param res  Receives the result if the operation completed.
+ * @return True if the operation completed; false if it is still in flight
+ *         (`RING_OP_TIMEOUT`) and completes later.
+ */
+bool ring_execute(struct process *proc, const struct ring_sqe *sqe, int32_t *res) {
+    char *buf = (char *)sqe->addr;
+
+    switch (sqe->opcode) {
+        case RING_OP_NOP:
+            *res = 0;
+            return true;
+        case RING_OP_READ:
+            for (uint32_t i = 0; i < sqe->len; i++)
+                buf[i] = getchar(TIMER_NEVER);
+            *res = sqe->len;
+            return true;
+        case RING_OP_WRITE:
+            for (uint32_t i = 0; i < sqe->len; i++)
+                putchar(buf[i]);
+            *res = sqe->len;
+            return true;
+        case RING_OP_READFILE:
+        case RING_OP_WRITEFILE:
+            *res = read_write_file((const char *)sqe->name, buf, sqe->len, sqe->opcode == RING_OP_WRITEFILE);
+            return true;
+        case RING_OP_TIMEOUT:
+            return !ring_arm_timeout(proc, sqe, res);
+        default:
+            *res = -EINVAL;
+            return true;
+    }
+}
+
+int32_t ring_enter(uint32_t to_submit, uint32_t min_complete) {
+    struct process *proc = get_current_process();
+    struct ring_state *ring = &proc->ring;
+    struct ioring *r = ring->shared;
+    if (!r)
+        return -EBADF;
+
+    uint32_t submitted = 0;
+    while (submitted < to_submit && r->sq_head != r->sq_tail) {
+        // Every operation in flight owns a completion slot, so nothing is
+        // submitted that could not post its completion.
+        if (r->cq_tail - r->cq_head + ring->inflight >= RING_ENTRIES)
+            break;
+
+        __sync_synchronize();  // Read the entry only after seeing the tail.
+        struct ring_sqe sqe = r->sqes[r->sq_head & RING_MASK];
+        r->sq_head++;
+        submitted++;
+
+        int32_t res;
+        ring->inflight++;
+        if (ring_execute(proc, &sqe, &res))
+            ring_complete(ring, sqe.user_data, res);
+    }
+
+    while (r->cq_tail - r->cq_head < min_complete && ring->inflight)
+        sleep_on(&ring->wait);
+
+    return submitted;
+}
+
+void ring_release(struct process *proc) {
+    for (size_t i = 0; i < RING_TIMEOUTS_MAX; i++)
+        timer_cancel(&proc->ring.timeouts[i].timer);
+    proc->ring.shared = NULL;
+    proc->ring.inflight = 0;
+}
@@ -1,7 +1,5 @@
 #include "sbi.h"
 
-#include "proc.h"
-#include "sys.h"
 #include "types.h"
 #include "utils.h"
 
@@ -39,7 +37,7 @@
  *
  * @example
  * @code
- * struct sbiret ret = sbi_call('A', 0, 0, 0, 0, 0, 0, SYS_PUTCHAR);
+ * struct sbiret ret = sbi_call('A', 0, 0, 0, 0, 0, 0, SBI_LEGACY_CONSOLE_PUTCHAR);
  * if (ret.error >= 0) {
  *     printf("Character '%c' written successfully.\n", (char)ret.error);
  * } else {
@@ -66,17 +64,13 @@ struct sbiret sbi_call(int32_t arg0, int32_t arg1, int32_t arg2, int32_t arg3,
 }
 
 void putchar(char ch) {
-    sbi_call(ch, 0, 0, 0, 0, 0, 0, SYS_PUTCHAR);
+    sbi_call(ch, 0, 0, 0, 0, 0, 0, SBI_LEGACY_CONSOLE_PUTCHAR);
 }
 
-int32_t getchar(void) {
-    while (true) {
-        struct sbiret ret = sbi_call(0, 0, 0, 0, 0, 0, 0, SYS_GETCHAR);
-        if (ret.error >= 0) return ret.error;
-        yield();
-    }
+void sbi_set_timer(uint64_t stime) {
+    sbi_call((uint32_t)stime, (uint32_t)(stime >> 32), 0, 0, 0, 0, 0, SBI_EXT_TIME);
 }
 
 void shutdown(void) {
-    sbi_call(0, 0, 0, 0, 0, 0, 0, SYS_SHUTDOWN);
+    sbi_call(0, 0, 0, 0, 0, 0, 0, SBI_LEGACY_SHUTDOWN);
 }
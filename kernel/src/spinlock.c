@@ -0,0 +1,17 @@
+#include "spinlock.h"
+
+#include "types.h"
+
+void acquire(struct spinlock *lock) {
+    // __sync_lock_test_and_set() compiles to amoswap.w.aq on RISC-V:
+    // atomically store 1 and return the previous value.
+    while (__sync_lock_test_and_set(&lock->locked, 1))
+        ;
+    __sync_synchronize();
+}
+
+void release(struct spinlock *lock) {
+    __sync_synchronize();
+    // Compiles to a store-release of 0 (amoswap.w.rl / fence + sw).
+    __sync_lock_release(&lock->locked);
+}
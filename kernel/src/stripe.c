@@ -0,0 +1,130 @@
+#include "stripe.h"
+
+#include "lib.h"
+#include "types.h"
+#include "utils.h"
+#include "virtio_disk.h"
+
+/**
+ * @brief The stripe over the scratch disks, set up by `init_stripe()`.
+ */
+struct stripe scratch_stripe;
+
+/**
+ * @brief `blkdev_ops` of a stripe; `priv` is the `struct stripe`.
+ */
+bool stripe_blkdev_read(struct blkdev *dev, void *buf, unsigned sector, unsigned count) {
+    return stripe_read_write(dev->priv, buf, sector, count, false);
+}
+
+bool stripe_blkdev_write(struct blkdev *dev, const void *buf, unsigned sector, unsigned count) {
+    return stripe_read_write(dev->priv, (void *)buf, sector, count, true);
+}
+
+bool stripe_blkdev_flush(struct blkdev *dev) {
+    struct stripe *s = dev->priv;
+    bool ok = true;
+    blkdev_request_start(dev);
+    for (unsigned i = 0; i < s->ndevs; i++)
+        ok &= blkdev_flush(&s->devs[i]->dev);
+    blkdev_request_end(dev);
+    return ok;
+}
+
+bool stripe_blkdev_discard(struct blkdev *dev, unsigned sector, unsigned count) {
+    struct stripe *s = dev->priv;
+    bool ok = true;
+    while (count > 0) {
+        unsigned chunk = sector / s->chunk_sectors, offset = sector % s->chunk_sectors;
+        unsigned n = s->chunk_sectors - offset;
+        if (n > count)
+            n = count;
+        ok &= blkdev_discard(&s->devs[chunk % s->ndevs]->dev, (chunk / s->ndevs) * s->chunk_sectors + offset, n);
+        sector += n;
+        count -= n;
+    }
+    return ok;
+}
+
+const struct blkdev_ops stripe_blkdev_ops = {
+    .read = stripe_blkdev_read,
+    .write = stripe_blkdev_write,
+    .flush = stripe_blkdev_flush,
+    .discard = stripe_blkdev_discard,
+    .write_zeroes = NULL,
+};
+
+void stripe_init(struct stripe *s, struct virtio_blk **devs, unsigned ndevs, unsigned chunk_sectors) {
+    unsigned smallest = devs[0]->capacity / SECTOR_SIZE;
+    for (unsigned i = 0; i < ndevs; i++) {
+        s->devs[i] = devs[i];
+        if (devs[i]->capacity / SECTOR_SIZE < smallest)
+            smallest = devs[i]->capacity / SECTOR_SIZE;
+    }
+    s->ndevs = ndevs;
+    s->chunk_sectors = chunk_sectors;
+
+    // Every device contributes the same number of whole chunks.
+    s->capacity = (smallest / chunk_sectors) * chunk_sectors * ndevs;
+
+    s->dev.name = "stripe0";
+    s->dev.ops = &stripe_blkdev_ops;
+    s->dev.priv = s;
+    s->dev.capacity = s->capacity;
+    s->dev.counts_requests = true;
+    s->dev.queue_depth = 0;
+    for (unsigned i = 0; i < ndevs; i++)
+        s->dev.queue_depth += devs[i]->dev.queue_depth;
+}
+
+/**
+ * @brief Context of `stripe_read_write()`: the stripe and the first sector.
+ */
+struct stripe_range {
+    struct stripe *s;
+    unsigned sector;
+};
+
+/**
+ * @brief `blk_piece_fn_t` of `stripe_read_write()`: each piece runs up to the end of its chunk.
+ */
+void stripe_piece(void *ctx, unsigned done, unsigned left, struct blk_piece *piece) {
+    struct stripe_range *range = ctx;
+    struct stripe *s = range->s;
+    unsigned pos = range->sector + done;
+    unsigned chunk = pos / s->chunk_sectors, offset = pos % s->chunk_sectors;
+    unsigned n = s->chunk_sectors - offset;
+    if (n > left)
+        n = left;
+    if (n > VIRTIO_BLK_RANGE_SECTORS)
+        n = VIRTIO_BLK_RANGE_SECTORS;
+
+    piece->blk = s->devs[chunk % s->ndevs];
+    piece->sector = (chunk / s->ndevs) * s->chunk_sectors + offset;
+    piece->count = n;
+}
+
+bool stripe_read_write(struct stripe *s, void *buf, unsigned sector, unsigned count, bool is_write) {
+    if (sector > s->capacity || count > s->capacity - sector) {
+        FAILED("stripe: tried to read/write %d sectors at sector=%d, but capacity is %d", count, sector, s->capacity);
+        return false;
+    }
+
+    struct stripe_range range = {.s = s, .sector = sector};
+    return blk_read_write_pieces(stripe_piece, &range, buf, count, is_write, &s->dev);
+}
+
+void init_stripe(void) {
+    unsigned ndevs = virtio_blk_count() - 1;
+    if (ndevs < 2)
+        return;
+
+    INFO("Initializing scratch stripe...");
+    struct virtio_blk *devs[STRIPE_DEVS_MAX];
+    for (unsigned i = 0; i < ndevs; i++)
+        devs[i] = virtio_blk_get(i + 1);
+    stripe_init(&scratch_stripe, devs, ndevs, STRIPE_CHUNK_SECTORS);
+    blkdev_register(&scratch_stripe.dev);
+    OK("Initialized scratch stripe: %d devices, %d-sector chunks, %d sectors.", ndevs, STRIPE_CHUNK_SECTORS,
+       scratch_stripe.capacity);
+}
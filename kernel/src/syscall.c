@@ -0,0 +1,175 @@
+#include "syscall.h"
+
+#include "alloc.h"
+#include "blkdev.h"
+#include "clock.h"
+#include "errno.h"
+#include "fs.h"
+#include "proc.h"
+#include "ring.h"
+#include "sbi.h"
+#include "stat.h"
+#include "sys.h"
+#include "timer.h"
+#include "types.h"
+#include "uart.h"
+#include "user.h"
+#include "utils.h"
+#include "virtio_disk.h"
+#include "vvar.h"
+#include "wait.h"
+
+/**
+ * @brief Linker-defined start of the kernel image; user memory lies below it.
+ */
+extern char __kernel_base[];
+
+int32_t sys_putchar(struct trap_frame *f) {
+    putchar(f->a0);
+    return 0;
+}
+
+int32_t sys_getchar(struct trap_frame *f) {
+    // a0: timeout in milliseconds, 0 waits forever.
+    int32_t ch = getchar(f->a0 ? get_time() + ms_to_ticks(f->a0) : TIMER_NEVER);
+    return ch < 0 ? -ETIMEDOUT : ch;
+}
+
+int32_t sys_exit(struct trap_frame *f) {
+    (void)f;
+    INFO("process %d exited", get_current_process()->pid);
+    exit_process();
+}
+
+int32_t read_write_file(const char *filename, char *buf, int32_t len, bool is_write) {
+    struct file *file = fs_lookup(filename);
+    if (!file) {
+        FAILED("file not found: %s\n", filename);
+        return -ENOENT;
+    }
+
+    if (len > (int32_t)sizeof(file->data)) {
+        if (is_write)
+            len = (int32_t)sizeof(file->data);
+        else
+            len = file->size;
+    }
+
+    if (is_write) {
+        memcpy(file->data, buf, len);
+        file->size = len;
+        flush_fs_async();  // Written back by the kernel worker; don't wait for the disk.
+    } else {
+        memcpy(buf, file->data, len);
+    }
+
+    return len;
+}
+
+int32_t sys_readfile(struct trap_frame *f) {
+    return read_write_file((const char *)f->a0, (char *)f->a1, f->a2, false);
+}
+
+int32_t sys_writefile(struct trap_frame *f) {
+    return read_write_file((const char *)f->a0, (char *)f->a1, f->a2, true);
+}
+
+int32_t sys_shutdown(struct trap_frame *f) {
+    (void)f;
+    sync_fs();  // Let pending write-backs reach the disk first.
+    virtio_blk_report();
+    INFO("Shuting down...");
+    shutdown();
+    return 0;
+}
+
+int32_t sys_pagestat(struct trap_frame *f) {
+    return page_cache_stats((struct pagestat *)f->a0, f->a1);
+}
+
+int32_t sys_nanosleep(struct trap_frame *f) {
+    // a0/a1: low/high word of the time in nanoseconds, a2: flags.
+    uint64_t ticks = ns_to_ticks(((uint64_t)f->a1 << 32) | f->a0);
+    sleep_on_timeout(NULL, (f->a2 & TIMER_ABSTIME) ? ticks : get_time() + ticks);
+    return 0;
+}
+
+int32_t sys_clock_gettime(struct trap_frame *f) {
+    *(uint64_t *)f->a0 = ticks_to_ns(get_time());
+    return 0;
+}
+
+int32_t sys_procstat(struct trap_frame *f) {
+    return proc_stats((struct procstat *)f->a0, f->a1);
+}
+
+int32_t sys_null(struct trap_frame *f) {
+    (void)f;
+    return 0;
+}
+
+int32_t sys_ring_setup(struct trap_frame *f) {
+    (void)f;
+    return ring_setup();
+}
+
+int32_t sys_ring_enter(struct trap_frame *f) {
+    return ring_enter(f->a0, f->a1);
+}
+
+int32_t sys_spawn(struct trap_frame *f) {
+    return spawn_program((const char *)f->a0, f->a1);
+}
+
+int32_t sys_wait(struct trap_frame *f) {
+    return wait_child(f->a0);
+}
+
+int32_t sys_sched_yield(struct trap_frame *f) {
+    (void)f;
+    yield();
+    return 0;
+}
+
+int32_t sys_diskread(struct trap_frame *f) {
+    // a0: block device handle, a1: first sector, a2: buffer, a3: number of
+    // sectors. Disk backends transfer straight into the caller's pages.
+    uint32_t count = f->a3;
+    if (count == 0 || count > VIRTIO_BLK_RANGE_SECTORS)
+        return -EINVAL;
+
+    // Disk backends treat kernel addresses as their own buffers, so a user
+    // buffer must not reach into the kernel range.
+    vaddr_t buf = f->a2;
+    if (buf < USER_BASE || buf >= (vaddr_t)__kernel_base || count * SECTOR_SIZE > (vaddr_t)__kernel_base - buf)
+        return -EFAULT;
+
+    struct blkdev *dev = blkdev_get(f->a0);
+    if (!dev)
+        return -ENODEV;
+    return blkdev_read(dev, (void *)buf, f->a1, count) ? (int32_t)(count * SECTOR_SIZE) : -EIO;
+}
+
+int32_t sys_iostat(struct trap_frame *f) {
+    return blkdev_iostat((struct iostat *)f->a0, f->a1);
+}
+
+/**
+ * @brief The system call table, indexed by system call number.
+ *
+ * Numbers without a system call are NULL.
+ */
+#define SYSCALL_TABLE_ENTRY(nr, name, nargs) [nr] = sys_##name,
+const syscall_handler_t syscall_table[] = {SYSCALLS(SYSCALL_TABLE_ENTRY)};
+
+void handle_syscall(struct trap_frame *f) {
+    uint32_t nr = f->a7;
+    vvar_count(&vvar->counters.syscalls);
+    if (nr >= sizeof(syscall_table) / sizeof(syscall_table[0]) || !syscall_table[nr]) {
+        FAILED("unknown syscall a7=%d", nr);
+        f->a0 = -ENOSYS;
+        return;
+    }
+
+    f->a0 = syscall_table[nr](f);
+}
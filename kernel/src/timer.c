@@ -0,0 +1,333 @@
+#include "timer.h"
+
+#include "clock.h"
+#include "lib.h"
+#include "proc.h"
+#include "riscv.h"
+#include "sbi.h"
+#include "types.h"
+#include "utils.h"
+
+/** Target length of a wheel tick in microseconds. */
+#define WHEEL_TICK_US 100
+
+/** Number of wheel ticks covered by the whole wheel. */
+#define WHEEL_RANGE ((uint64_t)1 << (WHEEL_LEVELS * WHEEL_BITS))
+
+/**
+ * @brief The timing wheel.
+ *
+ * - `wheel`:         Heads of the doubly linked timer lists, one per slot.
+ * - `wheel_bitmap`:  One bit per slot and level, set while the slot is not empty,
+ *                    so finding the next busy slot never walks empty ones.
+ * - `wheel_clk`:     The next wheel tick to process; everything before it has run.
+ * - `wheel_shift`:   log2 of the number of `time` CSR ticks per wheel tick.
+ * - `wheel_running`: Set while `wheel_run()` expires timers.
+ *
+ * A timer due at wheel tick `expires` is hashed into the lowest level whose
+ * range covers `expires - wheel_clk`, at slot `(expires >> (level * WHEEL_BITS)) % WHEEL_SLOTS`.
+ * When the clock reaches the start of a slot of a higher level, the timers in
+ * it are re-hashed into the lower levels, so only level 0 ever expires timers.
+ */
+struct timer *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+uint64_t wheel_bitmap[WHEEL_LEVELS];
+uint64_t wheel_clk;
+uint32_t wheel_shift;
+bool wheel_running;
+
+/**
+ * @struct timer_cpu
+ * @brief Per-hart scheduler tick state.
+ */
+struct timer_cpu {
+    uint64_t slice_end;   ///< End of the running process's time slice, or `TIMER_NEVER` if none is armed.
+    uint64_t programmed;  ///< Deadline currently programmed into the hardware timer.
+    bool need_resched;    ///< Set when the time slice expired; consumed by `timer_need_resched()`.
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct timer_cpu timer_cpus[HARTS_MAX];
+
+/**
+ * @brief Finds the lowest set bit of a non-zero bitmap.
+ *
+ * @param x The bitmap; must not be 0.
+ * @return Index of the lowest set bit.
+ */
+uint32_t first_bit(uint64_t x) {
+    uint32_t n = 0;
+    uint32_t word = (uint32_t)x;
+    if (!word) {
+        word = (uint32_t)(x >> 32);
+        n = 32;
+    }
+    for (uint32_t width = 16; width; width /= 2) {
+        if (!(word & ((1u << width) - 1))) {
+            word >>= width;
+            n += width;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Converts a deadline to the wheel tick it expires in.
+ *
+ * Rounds up, so a timer never fires before its deadline.
+ *
+ * @param deadline Absolute time in `time` CSR ticks.
+ * @return Absolute time in wheel ticks.
+ */
+uint64_t wheel_tick_of(uint64_t deadline) {
+    uint64_t tick = deadline >> wheel_shift;
+    if (deadline & (((uint64_t)1 << wheel_shift) - 1))
+        tick++;
+    return tick;
+}
+
+/**
+ * @brief Links a timer into the wheel slot matching its deadline.
+ *
+ * @param t The timer; `deadline` must be set.
+ */
+void wheel_insert(struct timer *t) {
+    uint64_t expires = wheel_tick_of(t->deadline);
+    if (expires < wheel_clk)
+        expires = wheel_clk;                    // Already due: expire at the next tick processed.
+    else if (expires - wheel_clk >= WHEEL_RANGE)
+        expires = wheel_clk + WHEEL_RANGE - 1;  // Too far away: park it, it is re-hashed later.
+
+    uint64_t delta = expires - wheel_clk;
+    uint32_t level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (uint64_t)1 << ((level + 1) * WHEEL_BITS))
+        level++;
+    uint32_t index = (expires >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1);
+
+    struct timer **head = &wheel[level][index];
+    t->prev = NULL;
+    t->next = *head;
+    if (*head)
+        (*head)->prev = t;
+    *head = t;
+    t->slot = level * WHEEL_SLOTS + index;
+    wheel_bitmap[level] |= (uint64_t)1 << index;
+}
+
+/**
+ * @brief Unlinks a timer from its wheel slot.
+ *
+ * @param t A timer currently linked into the wheel.
+ */
+void wheel_unlink(struct timer *t) {
+    uint32_t level = t->slot / WHEEL_SLOTS;
+    uint32_t index = t->slot % WHEEL_SLOTS;
+
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        wheel[level][index] = t->next;
+    if (t->next)
+        t->next->prev = t->prev;
+
+    if (!wheel[level][index])
+        wheel_bitmap[level] &= ~((uint64_t)1 << index);
+}
+
+/**
+ * @brief Computes the next wheel tick at which the wheel has work to do.
+ *
+ * That is the start of the next busy slot of any level: a level-0 slot holds
+ * timers to expire, a higher-level slot holds timers to re-hash. Slots behind
+ * the clock of their level only come up again after the level wraps around, so
+ * the wrap-around point is used for them. Only the bitmaps are inspected.
+ *
+ * @return The wheel tick, or `TIMER_NEVER` if the wheel is empty.
+ */
+uint64_t wheel_next_event(void) {
+    uint64_t next = TIMER_NEVER;
+
+    for (uint32_t level = 0; level < WHEEL_LEVELS; level++) {
+        uint64_t bitmap = wheel_bitmap[level];
+        if (!bitmap)
+            continue;
+
+        uint32_t shift = level * WHEEL_BITS;
+        uint64_t pos = wheel_clk >> shift;
+        uint32_t index = pos & (WHEEL_SLOTS - 1);
+
+        // The slot under the clock is still to be processed only if the clock
+        // sits exactly at its start.
+        uint32_t first = (wheel_clk & (((uint64_t)1 << shift) - 1)) ? index + 1 : index;
+        uint64_t ahead = first < WHEEL_SLOTS ? bitmap & ~(((uint64_t)1 << first) - 1) : 0;
+
+        uint64_t at;
+        if (ahead)
+            at = (pos + first_bit(ahead) - index) << shift;
+        else
+            at = ((pos >> WHEEL_BITS) + 1) << (shift + WHEEL_BITS);
+
+        if (at < next)
+            next = at;
+    }
+
+    return next;
+}
+
+/**
+ * @brief Re-hashes the timers of a higher-level slot into the lower levels.
+ *
+ * @param level Wheel level (1 or above).
+ * @param index Slot within the level.
+ */
+void wheel_cascade(uint32_t level, uint32_t index) {
+    struct timer *t = wheel[level][index];
+    wheel[level][index] = NULL;
+    wheel_bitmap[level] &= ~((uint64_t)1 << index);
+
+    while (t) {
+        struct timer *next = t->next;
+        wheel_insert(t);
+        t = next;
+    }
+}
+
+/**
+ * @brief Runs the callbacks of all timers in a level-0 slot.
+ *
+ * Callbacks may re-arm timers that are already due; they land in the same slot
+ * and are run by the same call.
+ *
+ * @param index Slot within level 0.
+ */
+void wheel_expire(uint32_t index) {
+    struct timer *t;
+    while ((t = wheel[0][index])) {
+        wheel_unlink(t);
+        t->pending = false;
+        t->callback(t);
+    }
+}
+
+/**
+ * @brief Advances the wheel clock up to and including `now`.
+ *
+ * Ticks in which nothing happens are skipped, so the cost depends on the number
+ * of busy slots and not on how long the hart has been idle.
+ *
+ * @param now The current time in wheel ticks.
+ */
+void wheel_run(uint64_t now) {
+    wheel_running = true;
+
+    while (wheel_clk <= now) {
+        uint64_t next = wheel_next_event();
+        if (next > now) {
+            wheel_clk = now + 1;
+            break;
+        }
+        wheel_clk = next;
+
+        for (uint32_t level = 1; level < WHEEL_LEVELS; level++) {
+            uint32_t shift = level * WHEEL_BITS;
+            if (wheel_clk & (((uint64_t)1 << shift) - 1))
+                break;
+            wheel_cascade(level, (wheel_clk >> shift) & (WHEEL_SLOTS - 1));
+        }
+
+        wheel_expire(wheel_clk & (WHEEL_SLOTS - 1));
+        wheel_clk++;
+    }
+
+    wheel_running = false;
+}
+
+void init_timer(void) {
+    // Pick the power-of-two number of ticks closest above WHEEL_TICK_US, so that
+    // converting a deadline to a wheel tick is a shift.
+    uint32_t ticks = timebase_freq / (USEC_PER_SEC / WHEEL_TICK_US);
+    while (((uint32_t)1 << wheel_shift) < ticks)
+        wheel_shift++;
+    wheel_clk = get_time() >> wheel_shift;
+
+    struct timer_cpu *tc = &timer_cpus[cpu_id()];
+    tc->slice_end = TIMER_NEVER;
+    tc->programmed = TIMER_NEVER;
+    sbi_set_timer(TIMER_NEVER);
+    WRITE_CSR(sie, READ_CSR(sie) | SIE_STIE);
+}
+
+void timer_cancel(struct timer *t) {
+    if (!t->pending)
+        return;
+
+    wheel_unlink(t);
+    t->pending = false;
+}
+
+void timer_add(struct timer *t, uint64_t deadline) {
+    timer_cancel(t);
+
+    // The clock only advances in timer interrupts. If nothing is due before now,
+    // catch it up so the new timer is hashed relative to the present.
+    uint64_t now = get_time() >> wheel_shift;
+    if (!wheel_running && wheel_clk < now && wheel_next_event() > now)
+        wheel_clk = now;
+
+    t->deadline = deadline;
+    t->pending = true;
+    wheel_insert(t);
+
+    timer_reprogram();
+}
+
+void timer_reprogram(void) {
+    struct timer_cpu *tc = &timer_cpus[cpu_id()];
+    struct process *current = get_current_process();
+
+    uint64_t next = wheel_next_event();
+    uint64_t deadline = next == TIMER_NEVER ? TIMER_NEVER : next << wheel_shift;
+
+    // Tick only while there is contention for the CPU.
+    if (current && current->pid != 0 && nr_runnable() > 1) {
+        if (tc->slice_end == TIMER_NEVER)
+            tc->slice_end = get_time() + ms_to_ticks(TIME_SLICE_MS);
+        if (tc->slice_end < deadline)
+            deadline = tc->slice_end;
+    } else {
+        tc->slice_end = TIMER_NEVER;
+    }
+
+    if (deadline == tc->programmed)
+        return;
+
+    tc->programmed = deadline;
+    sbi_set_timer(deadline);
+}
+
+void timer_new_slice(void) {
+    timer_cpus[cpu_id()].slice_end = TIMER_NEVER;
+    timer_reprogram();
+}
+
+void timer_intr(void) {
+    struct timer_cpu *tc = &timer_cpus[cpu_id()];
+    uint64_t now = get_time();
+
+    wheel_run(now >> wheel_shift);
+
+    if (tc->slice_end <= now) {
+        tc->slice_end = TIMER_NEVER;
+        tc->need_resched = true;
+    }
+
+    // The SBI only clears the pending interrupt when a new deadline is set,
+    // so always program the hardware here (TIMER_NEVER clears it too).
+    tc->programmed = 0;
+    timer_reprogram();
+}
+
+bool timer_need_resched(void) {
+    struct timer_cpu *tc = &timer_cpus[cpu_id()];
+    bool need_resched = tc->need_resched;
+    tc->need_resched = false;
+    return need_resched;
+}
@@ -1,85 +1,38 @@
 #include "trampoline.h"
 
-#include "fs.h"
+#include "plic.h"
 #include "proc.h"
 #include "riscv.h"
-#include "sbi.h"
 #include "sys.h"
+#include "syscall.h"
+#include "timer.h"
 #include "types.h"
+#include "uart.h"
 #include "utils.h"
+#include "virtio_disk.h"
+#include "vvar.h"
 
-/**
- * @brief Handles system calls made by user processes.
- *
- * This function dispatches system calls based on the value in register `a3` of the provided
- * trap frame. The following system calls are supported:
- *
- * - `SYS_PUTCHAR`: Writes a character (from `a0`) to the console.
- * - `SYS_GETCHAR`: Reads a character from the console into `a0`.
- * - `SYS_EXIT`: Marks the current process as exited and yields the CPU.
- * - `SYS_READFILE`: Reads data from a file specified by `a0` into a buffer at `a1`.
- * - `SYS_WRITEFILE`: Writes data from a buffer at `a1` to a file specified by `a0`.
- * - `SYS_SHUTDOWN`: Initiates system shutdown.
- *
- * For `SYS_READFILE` and `SYS_WRITEFILE`:
- * - `a0`: const char* (filename)
- * - `a1`: char* (buffer)
- * - `a2`: int32_t (length to read/write)
- *
- * @param f Pointer to the trap frame containing syscall arguments and return values.
- *
- * @note The function will panic if an unrecognized syscall number is encountered.
- */
-void handle_syscall(struct trap_frame *f) {
-    switch (f->a3) {
-        case SYS_PUTCHAR:
-            putchar(f->a0);
+void handle_interrupt(uint32_t code) {
+    vvar_count(&vvar->counters.interrupts);
+    switch (code) {
+        case IRQ_S_TIMER:
+            timer_intr();
             break;
-        case SYS_GETCHAR:
-            f->a0 = getchar();
-            break;
-        case SYS_EXIT:
-            struct process *current_process = get_current_process();
-            INFO("process %d exited", current_process->pid);
-            current_process->state = PROC_EXITED;
-            yield();
-            PANIC("unreachable");
-            break;
-        case SYS_READFILE:
-        case SYS_WRITEFILE:
-            const char *filename = (const char *)f->a0;
-            char *buf = (char *)f->a1;
-            int32_t len = f->a2;
-            struct file *file = fs_lookup(filename);
-            if (!file) {
-                FAILED("file not found: %s\n", filename);
-                f->a0 = -1;
-                break;
-            }
-
-            if (len > (int32_t)sizeof(file->data)) {
-                if (f->a3 == SYS_WRITEFILE)
-                    len = (int32_t)sizeof(file->data);
-                else
-                    len = file->size;
-            }
-
-            if (f->a3 == SYS_WRITEFILE) {
-                memcpy(file->data, buf, len);
-                file->size = len;
-                flush_fs();
-            } else {
-                memcpy(buf, file->data, len);
-            }
+        case IRQ_S_EXT: {
+            uint32_t irq = plic_claim();
+            if (irq == UART0_IRQ)
+                uart_intr();
+            else if (irq >= VIRTIO_MMIO_IRQ(0) && irq < VIRTIO_MMIO_IRQ(VIRTIO_MMIO_SLOTS))
+                virtio_blk_intr(irq);
+            else if (irq)
+                FAILED("unexpected irq=%d", irq);
 
-            f->a0 = len;
-            break;
-        case SYS_SHUTDOWN:
-            INFO("Shuting down...");
-            shutdown();
+            if (irq)
+                plic_complete(irq);
             break;
+        }
         default:
-            PANIC("unexpected syscall a3=0x%x\n", f->a3);
+            PANIC("unexpected interrupt code=%d", code);
     }
 }
 
@@ -93,6 +46,7 @@ void handle_syscall(struct trap_frame *f) {
  * at the time of trap respectively.
  *
  * If the trap is an environment call (`ECALL`), it is handled via `handle_syscall()`.
+ * Interrupts are handled via `handle_interrupt()`.
  * All other traps cause a system panic with diagnostic information.
  *
  * ---
@@ -146,18 +100,37 @@ void handle_trap(struct trap_frame *f) {
     uint32_t user_pc = READ_CSR(sepc);  // Stores the address of the instruction that caused the trap.
                                         // This is useful for resuming execution after handling an exception.
 
+    account_trap_enter();  // Everything since the last accounting point ran in user mode.
+
     if (scause == SCAUSE_ECALL) {
         handle_syscall(f);
         user_pc += 4;  // moves the program counter forward to skip the ecall instruction.
                        //  Else trap will be executed endlessly
                        //  In RV32I, RV64I, and RV128I, all instructions are 32-bit (4 bytes).
+    } else if (scause & SCAUSE_INTERRUPT) {
+        handle_interrupt(scause & ~SCAUSE_INTERRUPT);  // Resume the interrupted instruction.
+        if (timer_need_resched())
+            preempt();  // Time slice used up while others are waiting.
     } else {
         PANIC("unexpected trap scause=0x%x, stval=0x%x, sepc=0x%x\n", scause, stval, user_pc);
     }
 
     WRITE_CSR(sepc, user_pc);  // Resume execution from updated PC
+    account_trap_exit();       // Everything since trap entry ran in the kernel.
+}
+
+void handle_ecall(struct trap_frame *f) {
+    uint32_t user_pc = READ_CSR(sepc);
+
+    account_trap_enter();
+    handle_syscall(f);
+
+    WRITE_CSR(sepc, user_pc + 4);  // Skip the ecall instruction.
+    account_trap_exit();
 }
 
+_Static_assert(sizeof(struct trap_frame) == TRAP_FRAME_WORDS * 4, "trampoline() assumes a 32-word trap frame");
+
 __attribute__((naked))
 // Adding __attribute__((aligned(4))) aligns the function's starting address to a 4-byte boundary.
 // This is because the stvec register not only holds the address of the exception handler but also has flags representing the mode in its lower 2 bits.
@@ -170,15 +143,23 @@ trampoline(void) {
         // Retrieve the kernel stack of the running process from sscratch.
         "csrrw sp, sscratch, sp\n"
 
-        // Allocate space on the stack for 31 registers (each 4 bytes)
-        "addi sp, sp, -4 * 31\n"
+        // Allocate space on the stack for the trap frame (32 words, keeps sp 16-byte aligned)
+        "addi sp, sp, -4 * 32\n"
 
-        // Save caller-saved registers (ra, gp, tp, t0-t6, a0-a7, s0-s11) to the stack
+        // t0 is needed as a scratch register to look at scause.
+        "sw t0,  4 * 3(sp)\n"
+#if TRAP_FAST_PATH
+        // System calls take the fast path below.
+        "csrr t0, scause\n"
+        "addi t0, t0, -8\n"  // SCAUSE_ECALL
+        "beqz t0, 1f\n"
+#endif
+
+        // Save the remaining registers (ra, gp, tp, t1-t6, a0-a7, s0-s11) to the stack
         "sw ra,  4 * 0(sp)\n"  // Save return address
         "sw gp,  4 * 1(sp)\n"  // Save global pointer
         "sw tp,  4 * 2(sp)\n"  // Save thread pointer
-        "sw t0,  4 * 3(sp)\n"  // Save temporary registers
-        "sw t1,  4 * 4(sp)\n"
+        "sw t1,  4 * 4(sp)\n"  // Save temporary registers
         "sw t2,  4 * 5(sp)\n"
         "sw t3,  4 * 6(sp)\n"
         "sw t4,  4 * 7(sp)\n"
@@ -209,8 +190,12 @@ trampoline(void) {
         "csrr a0, sscratch\n"
         "sw a0,  4 * 30(sp)\n"
 
+        // Load the hart ID stashed right above the kernel stack by yield() into tp.
+        // The user's tp has already been saved to the trap frame.
+        "lw tp,  4 * 32(sp)\n"
+
         // Reset the kernel stack.
-        "addi a0, sp, 4 * 31\n"
+        "addi a0, sp, 4 * 32\n"
         "csrw sscratch, a0\n"
 
         // Pass stack pointer as an argument to handle_trap
@@ -253,5 +238,57 @@ trampoline(void) {
         "lw sp,  4 * 30(sp)\n"
 
         // Return from trap (switch back to previous privilege mode)
-        "sret\n");
+        "sret\n"
+
+#if TRAP_FAST_PATH
+        // Fast path for ecall: save only what handle_ecall() may clobber. The
+        // callee-saved registers s0-s11 are preserved by the C code (and by
+        // switch_context() if the system call blocks), and gp is unused.
+        "1:\n"
+        "sw ra,  4 * 0(sp)\n"
+        "sw tp,  4 * 2(sp)\n"
+        "sw t1,  4 * 4(sp)\n"
+        "sw t2,  4 * 5(sp)\n"
+        "sw t3,  4 * 6(sp)\n"
+        "sw t4,  4 * 7(sp)\n"
+        "sw t5,  4 * 8(sp)\n"
+        "sw t6,  4 * 9(sp)\n"
+        "sw a0,  4 * 10(sp)\n"
+        "sw a1,  4 * 11(sp)\n"
+        "sw a2,  4 * 12(sp)\n"
+        "sw a3,  4 * 13(sp)\n"
+        "sw a4,  4 * 14(sp)\n"
+        "sw a5,  4 * 15(sp)\n"
+        "sw a6,  4 * 16(sp)\n"
+        "sw a7,  4 * 17(sp)\n"
+        "csrr t0, sscratch\n"
+        "sw t0,  4 * 30(sp)\n"
+        "lw tp,  4 * 32(sp)\n"
+        "addi t0, sp, 4 * 32\n"
+        "csrw sscratch, t0\n"
+
+        "mv a0, sp\n"
+        "call handle_ecall\n"
+
+        "lw ra,  4 * 0(sp)\n"
+        "lw tp,  4 * 2(sp)\n"
+        "lw t0,  4 * 3(sp)\n"
+        "lw t1,  4 * 4(sp)\n"
+        "lw t2,  4 * 5(sp)\n"
+        "lw t3,  4 * 6(sp)\n"
+        "lw t4,  4 * 7(sp)\n"
+        "lw t5,  4 * 8(sp)\n"
+        "lw t6,  4 * 9(sp)\n"
+        "lw a0,  4 * 10(sp)\n"
+        "lw a1,  4 * 11(sp)\n"
+        "lw a2,  4 * 12(sp)\n"
+        "lw a3,  4 * 13(sp)\n"
+        "lw a4,  4 * 14(sp)\n"
+        "lw a5,  4 * 15(sp)\n"
+        "lw a6,  4 * 16(sp)\n"
+        "lw a7,  4 * 17(sp)\n"
+        "lw sp,  4 * 30(sp)\n"
+        "sret\n"
+#endif
+    );
 }
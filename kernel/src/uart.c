@@ -0,0 +1,72 @@
+#include "uart.h"
+
+#include "lib.h"
+#include "plic.h"
+#include "timer.h"
+#include "types.h"
+#include "utils.h"
+#include "wait.h"
+
+/**
+ * @brief Console receive ring buffer.
+ *
+ * Filled by `uart_intr()` and consumed by `getchar()`. The indices increase
+ * monotonically; `rx_write - rx_read` is the number of buffered characters.
+ */
+uint8_t rx_buf[UART_RX_BUF_SIZE];
+uint32_t rx_read;
+uint32_t rx_write;
+
+/**
+ * @brief Processes waiting for console input.
+ */
+struct wait_queue console_wq;
+
+/**
+ * @brief Reads an 8-bit UART register.
+ *
+ * @param reg Register offset from `UART0_PADDR`.
+ * @return The register value.
+ */
+uint8_t uart_reg_read(unsigned reg) {
+    return *(volatile uint8_t *)(UART0_PADDR + reg);
+}
+
+/**
+ * @brief Writes an 8-bit UART register.
+ *
+ * @param reg   Register offset from `UART0_PADDR`.
+ * @param value The value to write.
+ */
+void uart_reg_write(unsigned reg, uint8_t value) {
+    *(volatile uint8_t *)(UART0_PADDR + reg) = value;
+}
+
+void init_uart(void) {
+    INFO("Initializing uart...");
+    uart_reg_write(UART_IER, UART_IER_RX_ENABLE);
+    plic_enable(UART0_IRQ, 1);
+    OK("Initialized uart.");
+}
+
+void uart_intr(void) {
+    while (uart_reg_read(UART_LSR) & UART_LSR_RX_READY) {
+        uint8_t ch = uart_reg_read(UART_RBR);
+        if (rx_write - rx_read == UART_RX_BUF_SIZE)
+            continue;  // Buffer full: drop the character.
+        rx_buf[rx_write++ % UART_RX_BUF_SIZE] = ch;
+    }
+
+    wake_up(&console_wq);
+}
+
+int32_t getchar(uint64_t deadline) {
+    while (rx_read == rx_write) {
+        if (deadline == TIMER_NEVER)
+            sleep_on(&console_wq);
+        else if (!sleep_on_timeout(&console_wq, deadline))
+            return -1;
+    }
+
+    return rx_buf[rx_read++ % UART_RX_BUF_SIZE];
+}
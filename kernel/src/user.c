@@ -1,6 +1,10 @@
 #include "user.h"
 
+#include "errno.h"
+#include "fdt.h"
+#include "lib.h"
 #include "proc.h"
+#include "str.h"
 #include "types.h"
 #include "utils.h"
 
@@ -26,6 +30,33 @@ extern char _binary_build_user_user_bin_start[];
  */
 extern char _binary_build_user_user_bin_size[];
 
+/**
+ * @brief Start address and size of the embedded benchmark program binary.
+ *
+ * Embedded with objcopy like the shell binary above.
+ */
+extern char _binary_build_bench_bench_bin_start[];
+extern char _binary_build_bench_bench_bin_size[];
+
+/**
+ * @struct program
+ * @brief A user program embedded into the kernel image.
+ */
+struct program {
+    const char *name;   ///< Name passed to `SYS_SPAWN`.
+    const char *image;  ///< Start of the flat binary.
+    size_t size;        ///< Size of the flat binary in bytes.
+};
+
+/**
+ * @brief All embedded user programs. The first one is started at boot unless
+ * the `init=` kernel argument names another.
+ */
+const struct program programs[] = {
+    {"shell", _binary_build_user_user_bin_start, (size_t)_binary_build_user_user_bin_size},
+    {"bench", _binary_build_bench_bench_bin_start, (size_t)_binary_build_bench_bench_bin_size},
+};
+
 /**
  * @brief Transfers control from supervisor mode to user mode.
  *
@@ -51,8 +82,73 @@ void user_entry(void) {
     );
 }
 
+/**
+ * @brief Looks up an embedded program by name.
+ *
+ * @param name Name of the program; need not be null-terminated.
+ * @param len  Length of `name`.
+ * @return The program, or NULL if there is none with that name.
+ */
+const struct program *find_program(const char *name, size_t len) {
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        const char *p = programs[i].name;
+        size_t j = 0;
+        while (j < len && p[j] == name[j])
+            j++;
+        if (j == len && p[j] == '\0')
+            return &programs[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Selects the program started at boot.
+ *
+ * Looks for an `init=<name>` argument in the kernel command line
+ * (`/chosen/bootargs`, set e.g. with QEMU's `-append`).
+ *
+ * @return The program named by `init=`, or the shell by default.
+ */
+const struct program *find_init_program(void) {
+    uint32_t len;
+    const char *name = fdt_bootarg("init", &len);
+    if (name) {
+        const struct program *program = find_program(name, len);
+        if (program)
+            return program;
+
+        // The value is not NUL-terminated: the rest of the bootargs follows it.
+        char buf[32];
+        if (len >= sizeof(buf))
+            len = sizeof(buf) - 1;
+        memcpy(buf, name, len);
+        buf[len] = '\0';
+        FAILED("unknown init program in bootargs: %s", buf);
+    }
+
+    return &programs[0];
+}
+
 void init_user(void) {
     INFO("Initializing user process...");
-    create_process(_binary_build_user_user_bin_start, (size_t)_binary_build_user_user_bin_size, USER_BASE, (const vaddr_t)user_entry);
-    OK("Initialized user process.");
+    const struct program *init = find_init_program();
+    if (!create_process(init->image, init->size, USER_BASE, (const vaddr_t)user_entry))
+        PANIC("no free process slots");
+    OK("Initialized user process: %s.", init->name);
+}
+
+int32_t spawn_program(const char *name, int32_t arg) {
+    const struct program *program = find_program(name, strlen((char *)name));
+    if (!program)
+        return -ENOENT;
+
+    struct process *proc = create_process(program->image, program->size, USER_BASE, (const vaddr_t)user_entry);
+    if (!proc)
+        return -EAGAIN;
+
+    proc->parent = get_current_process();
+    proc->vdso->ppid = proc->parent->pid;
+    proc->vdso->arg = arg;
+    return proc->pid;
 }
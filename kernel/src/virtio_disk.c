@@ -2,68 +2,79 @@
 
 #include "alloc.h"
 #include "arg.h"
+#include "clock.h"
+#include "plic.h"
+#include "proc.h"
+#include "riscv.h"
+#include "str.h"
+#include "timer.h"
 #include "utils.h"
 #include "virtio.h"
+#include "vm.h"
+#include "wait.h"
 
-/**
- * @brief Pointer to the Virtqueue used for sending block device requests.
- *
- * This queue is used by the driver to enqueue read/write requests which the VirtIO block device processes.
- */
-struct virtio_virtq *blk_request_vq;
+_Static_assert(sizeof(struct virtq_desc) == 16 && sizeof(struct virtq_packed_desc) == 16,
+               "virtqueue descriptors are 16 bytes");
+_Static_assert(sizeof(struct virtq_used_elem) == 8, "used ring elements are 8 bytes");
 
 /**
- * @brief Pointer to the current VirtIO block request structure.
- *
- * Contains information such as the operation type (read/write), target sector,
- * data buffer, and status field for the request.
+ * @brief Linker-defined bounds of the memory the kernel maps identically into every address space.
  */
-struct virtio_blk_req *blk_req;
+extern char __kernel_base[], __free_ram_end[];
 
 /**
- * @brief Physical address of the block request structure.
+ * @brief Block devices found by `init_virtio_blk()`, indexed by handle.
  *
- * This is the physical memory address of `blk_req` and is shared with the device
- * so it can access the memory for processing I/O.
+ * Device memory that the device accesses (rings, request slots) comes from
+ * `alloc_pages()`: the kernel is identity-mapped, so the address of a slot is
+ * also the physical address the device accesses it at.
  */
-paddr_t blk_req_paddr;
+struct virtio_blk blk_devs[VIRTIO_BLK_DEVS_MAX];
+unsigned blk_num_devs;
 
 /**
- * @brief Capacity of the VirtIO block device in sectors.
+ * @brief Reads a 32-bit value from a VirtIO device register.
  *
- * Represents the total number of 512-byte sectors that the block device can store.
+ * @param regs   Base address of the device's virtio-mmio registers.
+ * @param offset Offset (in bytes) from the base physical address of the VirtIO device.
+ * @return The 32-bit value read from the specified register.
  */
-unsigned blk_capacity;
+uint32_t virtio_reg_read32(paddr_t regs, unsigned offset) {
+    return *(volatile uint32_t *)(regs + offset);
+}
 
 /**
- * @brief Reads a 32-bit value from a VirtIO device register.
+ * @brief Reads a 16-bit value from a VirtIO device register.
  *
- * @param offset Offset (in bytes) from the base physical address of the VirtIO block device.
- * @return The 32-bit value read from the specified register.
+ * @param regs   Base address of the device's virtio-mmio registers.
+ * @param offset Offset (in bytes) from the base physical address of the VirtIO device.
+ * @return The 16-bit value read from the specified register.
  */
-uint32_t virtio_reg_read32(unsigned offset) {
-    return *(volatile uint32_t *)(VIRTIO_BLK_PADDR + offset);
+uint16_t virtio_reg_read16(paddr_t regs, unsigned offset) {
+    return *(volatile uint16_t *)(regs + offset);
 }
 
 /**
  * @brief Reads a 64-bit value from a VirtIO device register.
  *
- * @param offset Offset (in bytes) from the base physical address of the VirtIO block device.
+ * @param regs   Base address of the device's virtio-mmio registers.
+ * @param offset Offset (in bytes) from the base physical address of the VirtIO device.
  * @return The 64-bit value read from the specified register.
  */
 
-uint64_t virtio_reg_read64(unsigned offset) {
-    return *(volatile uint64_t *)(VIRTIO_BLK_PADDR + offset);
+uint64_t virtio_reg_read64(paddr_t regs, unsigned offset) {
+    return *(volatile uint64_t *)(regs + offset);
 }
 
 /**
  * @brief Writes a 32-bit value to a VirtIO device register.
  *
- * @param offset Offset (in bytes) from the base physical address of the VirtIO block device.
+ * @param regs   Base address of the device's virtio-mmio registers.
+ * @param offset Offset (in bytes) from the base physical address of the VirtIO device.
  * @param value The 32-bit value to write.
  */
-void virtio_reg_write32(unsigned offset, uint32_t value) {
-    *(volatile uint32_t *)(VIRTIO_BLK_PADDR + offset) = value;
+void virtio_reg_write32(paddr_t regs, unsigned offset, uint32_t value) {
+    *(volatile uint32_t *)(regs + offset) = value;
 }
 
 /**
@@ -72,47 +83,315 @@ void virtio_reg_write32(unsigned offset, uint32_t value) {
  * This function reads the current value of the register, performs a bitwise OR with the provided value,
  * and writes the result back to the register.
  *
- * @param offset Offset (in bytes) from the base physical address of the VirtIO block device.
+ * @param regs   Base address of the device's virtio-mmio registers.
+ * @param offset Offset (in bytes) from the base physical address of the VirtIO device.
  * @param value The value to OR with the existing register value.
  */
-void virtio_reg_fetch_and_or32(unsigned offset, uint32_t value) {
-    virtio_reg_write32(offset, virtio_reg_read32(offset) | value);
+void virtio_reg_fetch_and_or32(paddr_t regs, unsigned offset, uint32_t value) {
+    virtio_reg_write32(regs, offset, virtio_reg_read32(regs, offset) | value);
 }
 
 /**
- * @brief Checks if the Virtqueue has pending requests still being processed by the device.
+ * @brief Takes a descriptor from the free list.
  *
- * Compares the driver's `last_seen_used_index` with the device-maintained `used.index`.
- * If they are unequal, it means the device has not yet completed all submitted requests.
+ * @param vq Pointer to the VirtIO virtqueue.
+ * @return Index of the descriptor. The caller must make sure one is free.
+ */
+uint16_t virtq_alloc_desc(struct virtio_virtq *vq) {
+    uint16_t index = vq->free_head;
+    vq->free_head = vq->descs[index].next;
+    vq->num_free--;
+    return index;
+}
+
+/**
+ * @brief Returns a descriptor chain to the free list.
  *
- * @param vq Pointer to the VirtIO virtqueue structure to check.
- * @return `true` if there are unprocessed requests, `false` otherwise.
+ * @param vq   Pointer to the VirtIO virtqueue.
+ * @param head Index of the first descriptor of the chain.
  */
-bool virtq_is_busy(struct virtio_virtq *vq) {
-    // last_used_index tracks curent position where used.index should be
-    // after completing all the operations, if they are not equal that
-    // means Device has not processed all the requests yet.
-    return vq->last_seen_used_index != *vq->used_index;
+void virtq_free_chain(struct virtio_virtq *vq, uint16_t head) {
+    uint16_t index = head;
+    while (true) {
+        bool has_next = vq->descs[index].flags & VIRTQ_DESC_F_NEXT;
+        uint16_t next = vq->descs[index].next;
+        vq->descs[index].next = vq->free_head;
+        vq->free_head = index;
+        vq->num_free++;
+        if (!has_next)
+            break;
+        index = next;
+    }
 }
 
 /**
- * @brief Notifies the VirtIO device of a new request in the virtqueue.
+ * @brief Checks whether the driver must notify the device after adding buffers.
  *
- * Adds the descriptor index to the available ring and updates the index,
- * then writes to the device's queue notify register to inform it that
- * a new buffer is ready for processing.
+ * With event-idx the device asks to be notified only when the driver's
+ * position moves past `event`. While it is still working through earlier
+ * requests it will see the new ones anyway, so the notification (an MMIO
+ * write that traps into the hypervisor) can be skipped.
  *
- * @param vq Pointer to the VirtIO virtqueue.
- * @param desc_index Index of the head descriptor of the new request.
+ * @param event Position the device wants to be notified at.
+ * @param next  Position after the new buffers.
+ * @param old   Position before the new buffers.
+ * @return True if `event` lies in [old, next).
+ */
+bool virtq_need_event(uint16_t event, uint16_t next, uint16_t old) {
+    return (uint16_t)(next - event - 1) < (uint16_t)(next - old);
+}
+
+/**
+ * @brief Makes a descriptor chain available in a split virtqueue.
+ *
+ * Takes the descriptors from the free list, adds the head to the available
+ * ring and updates the index.
+ *
+ * @param vq    Pointer to the VirtIO virtqueue.
+ * @param chain The chain; `next` fields are filled in here.
+ * @param n     Number of descriptors in `chain`.
+ * @param id    Buffer id returned by `virtq_get_used()` on completion.
+ * @return True if the device must be notified.
+ */
+bool virtq_add_split(struct virtio_virtq *vq, const struct virtq_desc *chain, unsigned n, uint16_t id) {
+    uint16_t head = virtq_alloc_desc(vq), prev = head;
+    vq->descs[head] = chain[0];
+    for (unsigned i = 1; i < n; i++) {
+        uint16_t d = virtq_alloc_desc(vq);
+        vq->descs[prev].next = d;
+        vq->descs[d] = chain[i];
+        prev = d;
+    }
+    vq->head_id[head] = id;
+
+    uint16_t old = vq->avail.index, next = old + 1;
+    vq->avail.ring[old % VIRTQ_ENTRY_NUM] = head;
+    __sync_synchronize();  // Publish the ring entry before the new index.
+    vq->avail.index = next;
+    __sync_synchronize();  // Publish the new index before reading avail_event.
+
+    if (vq->event_idx)
+        return virtq_need_event(*(volatile uint16_t *)&vq->used.avail_event, next, old);
+    return true;
+}
+
+/**
+ * @brief Makes a descriptor chain available in a packed virtqueue.
+ *
+ * Writes the chain into the next ring slots. Each descriptor becomes
+ * available when its `AVAIL`/`USED` bits match the driver's wrap counter, so
+ * the head's flags are written last: the device never sees a partial chain.
+ *
+ * @param vq    Pointer to the VirtIO virtqueue.
+ * @param chain The chain (`next` fields are ignored: a packed chain is consecutive).
+ * @param n     Number of descriptors in `chain`.
+ * @param id    Buffer id, stored in the descriptors and returned by the device.
+ * @return True if the device must be notified.
+ */
+bool virtq_add_packed(struct virtio_virtq *vq, const struct virtq_desc *chain, unsigned n, uint16_t id) {
+    struct virtq_packed *ring = vq->packed;
+    uint16_t head = vq->next_avail, head_flags = 0;
+    uint16_t wrap_flags = vq->avail_wrap ? VIRTQ_DESC_F_AVAIL : VIRTQ_DESC_F_USED;
+
+    for (unsigned i = 0; i < n; i++) {
+        struct virtq_packed_desc *desc = &ring->descs[vq->next_avail];
+        uint16_t flags = chain[i].flags | wrap_flags;
+        desc->addr = chain[i].addr;
+        desc->len = chain[i].len;
+        desc->id = id;
+        if (i == 0)
+            head_flags = flags;
+        else
+            desc->flags = flags;
+
+        if (++vq->next_avail == VIRTQ_ENTRY_NUM) {
+            vq->next_avail = 0;
+            vq->avail_wrap = !vq->avail_wrap;
+            wrap_flags = vq->avail_wrap ? VIRTQ_DESC_F_AVAIL : VIRTQ_DESC_F_USED;
+        }
+    }
+    vq->num_free -= n;
+    vq->chain_len[id] = n;
+
+    __sync_synchronize();  // Publish the rest of the chain before the head.
+    *(volatile uint16_t *)&ring->descs[head].flags = head_flags;
+    __sync_synchronize();  // Publish the head before reading the device's event suppression.
+
+    uint16_t event_flags = *(volatile uint16_t *)&ring->device.flags;
+    if (event_flags == VIRTQ_EVENT_F_DESC) {
+        // `off_wrap` names a ring slot and a wrap counter; unwrap it into the
+        // same index space as `head` and `next_avail`.
+        uint16_t off_wrap = *(volatile uint16_t *)&ring->device.off_wrap;
+        uint16_t event = off_wrap & 0x7fff;
+        if ((bool)(off_wrap >> 15) != vq->avail_wrap)
+            event -= VIRTQ_ENTRY_NUM;
+        uint16_t next = vq->next_avail;
+        uint16_t old = next - n;
+        return virtq_need_event(event, next, old);
+    }
+    return event_flags != VIRTQ_EVENT_F_DISABLE;
+}
+
+/**
+ * @brief Writes a chain into an indirect descriptor table.
+ *
+ * The table uses the descriptor format of the ring: linked split descriptors,
+ * or consecutive packed descriptors.
+ *
+ * @param vq    Pointer to the VirtIO virtqueue.
+ * @param table The table, 16-byte aligned, with room for `n` descriptors.
+ * @param chain The chain.
+ * @param n     Number of descriptors in `chain`.
+ * @return Size of the table in bytes.
  */
-void virtq_kick(struct virtio_virtq *vq, int desc_index) {
-    vq->avail.ring[vq->avail.index % VIRTQ_ENTRY_NUM] = desc_index;
-    vq->avail.index++;
-    __sync_synchronize();
+uint32_t virtq_write_indirect(struct virtio_virtq *vq, void *table, const struct virtq_desc *chain, unsigned n) {
+    for (unsigned i = 0; i < n; i++) {
+        if (vq->packed) {
+            struct virtq_packed_desc *desc = &((struct virtq_packed_desc *)table)[i];
+            desc->addr = chain[i].addr;
+            desc->len = chain[i].len;
+            desc->id = 0;
+            desc->flags = chain[i].flags & ~VIRTQ_DESC_F_NEXT;
+        } else {
+            struct virtq_desc *desc = &((struct virtq_desc *)table)[i];
+            *desc = chain[i];
+            desc->next = i + 1;
+        }
+    }
+    return n * sizeof(struct virtq_desc);
+}
+
+/**
+ * @brief Makes a descriptor chain available to the device and notifies it.
+ *
+ * Works for both ring layouts. The caller must make sure `n` descriptors are
+ * free. After adding the chain, writes to the device's queue notify register
+ * to inform it that a new buffer is ready for processing, unless the device
+ * has said that it does not need to be told.
+ *
+ * @param vq    Pointer to the VirtIO virtqueue.
+ * @param chain The chain: `addr`, `len` and `flags` of each descriptor, in order.
+ * @param n     Number of descriptors in `chain`.
+ * @param id    Buffer id (below `VIRTQ_ENTRY_NUM`) returned by `virtq_get_used()` on completion.
+ */
+void virtq_add(struct virtio_virtq *vq, const struct virtq_desc *chain, unsigned n, uint16_t id) {
+    bool notify = vq->packed ? virtq_add_packed(vq, chain, n, id) : virtq_add_split(vq, chain, n, id);
+    if (!notify)
+        return;
+
     // Notifies the VirtIO device that a new request is available in the queue
     // with queue number: vq->queue_index
-    virtio_reg_write32(VIRTIO_REG_QUEUE_NOTIFY, vq->queue_index);
+    virtio_reg_write32(vq->regs, VIRTIO_REG_QUEUE_NOTIFY, vq->queue_index);
+}
+
+/**
+ * @brief Takes the next buffer the device has used.
+ *
+ * Split ring: reads the next used ring entry, which names the head descriptor
+ * of the chain, and returns the chain to the free list. Packed ring: checks
+ * whether the next slot holds a used descriptor (both wrap bits equal to the
+ * expected used wrap counter) and skips the slots of its chain.
+ *
+ * @param vq Pointer to the VirtIO virtqueue.
+ * @param id Receives the buffer id given to `virtq_add()`.
+ * @return False if the device has not used any further buffer.
+ */
+bool virtq_get_used(struct virtio_virtq *vq, uint16_t *id) {
+    if (vq->packed) {
+        struct virtq_packed_desc *desc = &vq->packed->descs[vq->next_used];
+        uint16_t flags = *(volatile uint16_t *)&desc->flags;
+        bool avail = (flags & VIRTQ_DESC_F_AVAIL) != 0, used = (flags & VIRTQ_DESC_F_USED) != 0;
+        if (avail != vq->used_wrap || used != vq->used_wrap)
+            return false;
+        __sync_synchronize();  // Read the descriptor only after seeing its flags.
+
+        *id = desc->id;
+        vq->num_free += vq->chain_len[*id];
+        vq->next_used += vq->chain_len[*id];
+        if (vq->next_used >= VIRTQ_ENTRY_NUM) {
+            vq->next_used -= VIRTQ_ENTRY_NUM;
+            vq->used_wrap = !vq->used_wrap;
+        }
+        return true;
+    }
+
+    if (vq->last_seen_used_index == *vq->used_index)
+        return false;
+    __sync_synchronize();  // Read the entry only after seeing the index.
+
+    struct virtq_used_elem *elem = &vq->used.ring[vq->last_seen_used_index % VIRTQ_ENTRY_NUM];
     vq->last_seen_used_index++;
+    *id = vq->head_id[elem->id];
+    virtq_free_chain(vq, elem->id);
+    return true;
+}
+
+/**
+ * @brief Ends the use of a request's bounce buffer.
+ *
+ * The buffer stays with the slot for the next bounced request: multi-page
+ * blocks are never reused once freed, so they must not be allocated per request.
+ *
+ * @param r The request.
+ */
+void blk_release_bounce(struct blk_request *r) {
+    r->bounce = 0;
+}
+
+/**
+ * @brief Marks a request as done, and frees it if its issuer has given up on it.
+ *
+ * @param r The request.
+ */
+void blk_complete(struct blk_request *r) {
+    r->done = true;
+    if (r->abandoned) {
+        blk_release_bounce(r);
+        r->in_use = false;
+    }
+}
+
+/**
+ * @brief Processes the buffers the device has used.
+ *
+ * Each one is a completed request, identified by its slot in the request
+ * pool. The request and those merged into it are marked as done. Abandoned
+ * requests are freed right away.
+ *
+ * @param blk The device.
+ * @param vq  Pointer to one of its virtqueues.
+ * @return True if at least one request completed.
+ */
+bool virtq_process_used(struct virtio_blk *blk, struct virtio_virtq *vq) {
+    bool progress = false;
+    uint16_t id;
+
+again:
+    while (virtq_get_used(vq, &id)) {
+        struct blk_request *r = &blk->reqs[vq->queue_index * VIRTIO_BLK_REQS_MAX + id];
+        // Requests merged into the chain complete with it.
+        for (struct blk_request *m = r->merged; m; m = m->next) {
+            m->status = r->status;
+            blk_complete(m);
+        }
+        blk_complete(r);
+        blk->inflight--;
+        blkdev_request_end(&blk->dev);
+        progress = true;
+    }
+
+    // With event-idx the device interrupts only once it writes the used
+    // entry `used_event`: ask for the next one, so completions that arrive
+    // while we are still processing do not raise further interrupts. Then
+    // pick up an entry that may have raced with the update. (A packed ring
+    // keeps its driver event suppression at VIRTQ_EVENT_F_ENABLE.)
+    if (vq->event_idx && !vq->packed) {
+        vq->avail.used_event = vq->last_seen_used_index;
+        __sync_synchronize();
+        if (vq->last_seen_used_index != *vq->used_index)
+            goto again;
+    }
+    return progress;
 }
 
 /**
@@ -124,123 +403,916 @@ void virtq_kick(struct virtio_virtq *vq, int desc_index) {
  * The initialization process follows the VirtIO specification:
  * 1. Selects the desired queue by writing its index to the QueueSel register.
  * 2. Sets the queue size via QueueNum.
- * 3. Configures the memory alignment with QueueAlign.
- * 4. Informs the device of the queue’s physical address using QueuePFN.
+ * 3. Legacy transport: configures the memory alignment with QueueAlign and
+ *    informs the device of the queue’s physical address using QueuePFN.
+ *    Modern transport: informs the device of the addresses of the descriptor
+ *    table and both rings (or, for a packed ring, of the descriptor ring and
+ *    both event suppression structures), then sets QueueReady.
  *
- * @param index Index of the virtqueue to initialize (usually 0 for the first queue).
+ * @param regs     Base address of the device's virtio-mmio registers.
+ * @param version  Transport version of the device.
+ * @param index    Index of the virtqueue to initialize (usually 0 for the first queue).
+ * @param features Negotiated feature bits.
  * @return Pointer to the initialized `struct virtio_virtq`.
  */
-struct virtio_virtq *virtq_init(unsigned index) {
+struct virtio_virtq *virtq_init(paddr_t regs, uint32_t version, unsigned index, uint64_t features) {
     paddr_t virtq_paddr = alloc_pages(align_up(sizeof(struct virtio_virtq), PAGE_SIZE) / PAGE_SIZE);
     struct virtio_virtq *vq = (struct virtio_virtq *)virtq_paddr;
     vq->queue_index = index;
+    vq->regs = regs;
     vq->used_index = (volatile uint16_t *)&vq->used.index;
+    vq->event_idx = (features & VIRTIO_FEATURE(VIRTIO_RING_F_EVENT_IDX)) != 0;
+    vq->indirect = (features & VIRTIO_FEATURE(VIRTIO_RING_F_INDIRECT_DESC)) != 0;
+    if (features & VIRTIO_FEATURE(VIRTIO_F_RING_PACKED)) {
+        // Zeroed, so no descriptor is available yet: both wrap counters start at 1.
+        vq->packed = (struct virtq_packed *)alloc_pages(align_up(sizeof(struct virtq_packed), PAGE_SIZE) / PAGE_SIZE);
+        vq->avail_wrap = true;
+        vq->used_wrap = true;
+    }
+
+    // Chain all descriptors into the free list.
+    for (uint16_t i = 0; i < VIRTQ_ENTRY_NUM; i++)
+        vq->descs[i].next = i + 1;
+    vq->free_head = 0;
+    vq->num_free = VIRTQ_ENTRY_NUM;
 
     // 1. Select the queue by writing its index (first queue is 0) to QueueSel.
-    virtio_reg_write32(VIRTIO_REG_QUEUE_SEL, index);
+    virtio_reg_write32(regs, VIRTIO_REG_QUEUE_SEL, index);
+    if (virtio_reg_read32(regs, VIRTIO_REG_QUEUE_NUM_MAX) < VIRTQ_ENTRY_NUM)
+        PANIC("virtio: queue %d is smaller than %d entries", index, VIRTQ_ENTRY_NUM);
 
     // 2. Notify the device about the queue size by writing the size to QueueNum.
-    virtio_reg_write32(VIRTIO_REG_QUEUE_NUM, VIRTQ_ENTRY_NUM);
+    virtio_reg_write32(regs, VIRTIO_REG_QUEUE_NUM, VIRTQ_ENTRY_NUM);
+
+    if (version == 1) {
+        // 3. Notify the device about the alignment (0 = default PAGE_SIZE alignment).
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_ALIGN, 0);
 
-    // 3. Notify the device about the alignment (0 = default PAGE_SIZE alignment).
-    virtio_reg_write32(VIRTIO_REG_QUEUE_ALIGN, 0);
+        // 4. Provide the physical address of the queue.
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_PFN, virtq_paddr);
+    } else {
+        // 3. Provide the physical addresses of the three parts separately. A
+        // packed ring has a single descriptor ring, and its driver and device
+        // areas hold the event suppression structures instead of the rings.
+        bool packed = vq->packed != NULL;
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_DESC_LOW, packed ? (paddr_t)vq->packed->descs : (paddr_t)vq->descs);
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_DESC_HIGH, 0);
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_DRIVER_LOW, packed ? (paddr_t)&vq->packed->driver : (paddr_t)&vq->avail);
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_DRIVER_HIGH, 0);
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_DEVICE_LOW, packed ? (paddr_t)&vq->packed->device : (paddr_t)&vq->used);
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_DEVICE_HIGH, 0);
 
-    // 4. Provide the physical address of the queue.
-    virtio_reg_write32(VIRTIO_REG_QUEUE_PFN, virtq_paddr);
+        // 4. The queue is ready for use.
+        virtio_reg_write32(regs, VIRTIO_REG_QUEUE_READY, 1);
+    }
     return vq;
 }
 
-void init_virtio_blk(void) {
-    INFO("Initializing virtio block...");
+/**
+ * @brief Negotiates feature bits with the device.
+ *
+ * Reads the 64 feature bits the device offers, 32 at a time, and writes back
+ * those that the driver also supports.
+ *
+ * @param regs      Base address of the device's virtio-mmio registers.
+ * @param supported Feature bits the driver supports.
+ * @return The accepted feature bits.
+ */
+uint64_t virtio_negotiate_features(paddr_t regs, uint64_t supported) {
+    virtio_reg_write32(regs, VIRTIO_REG_DEVICE_FEATURES_SEL, 0);
+    uint64_t offered = virtio_reg_read32(regs, VIRTIO_REG_DEVICE_FEATURES);
+    virtio_reg_write32(regs, VIRTIO_REG_DEVICE_FEATURES_SEL, 1);
+    offered |= (uint64_t)virtio_reg_read32(regs, VIRTIO_REG_DEVICE_FEATURES) << 32;
+
+    uint64_t accepted = offered & supported;
+    virtio_reg_write32(regs, VIRTIO_REG_DRIVER_FEATURES_SEL, 0);
+    virtio_reg_write32(regs, VIRTIO_REG_DRIVER_FEATURES, (uint32_t)accepted);
+    virtio_reg_write32(regs, VIRTIO_REG_DRIVER_FEATURES_SEL, 1);
+    virtio_reg_write32(regs, VIRTIO_REG_DRIVER_FEATURES, (uint32_t)(accepted >> 32));
+    return accepted;
+}
+
+/**
+ * @brief `blkdev_ops` of a virtio block device; `priv` is the `struct virtio_blk`.
+ */
+bool virtio_blkdev_read(struct blkdev *dev, void *buf, unsigned sector, unsigned count) {
+    return read_write_disk_range(dev->priv, buf, sector, count, false);
+}
 
-    if (virtio_reg_read32(VIRTIO_REG_MAGIC) != 0x74726976)
-        PANIC("virtio: invalid magic value");
-    if (virtio_reg_read32(VIRTIO_REG_VERSION) != 1)
-        PANIC("virtio: invalid version");
-    if (virtio_reg_read32(VIRTIO_REG_DEVICE_ID) != VIRTIO_DEVICE_BLK)
-        PANIC("virtio: invalid device id");
+bool virtio_blkdev_write(struct blkdev *dev, const void *buf, unsigned sector, unsigned count) {
+    return read_write_disk_range(dev->priv, (void *)buf, sector, count, true);
+}
+
+bool virtio_blkdev_flush(struct blkdev *dev) {
+    return blk_flush(dev->priv);
+}
+
+bool virtio_blkdev_discard(struct blkdev *dev, unsigned sector, unsigned count) {
+    return blk_discard(dev->priv, sector, count);
+}
+
+bool virtio_blkdev_write_zeroes(struct blkdev *dev, unsigned sector, unsigned count) {
+    return blk_write_zeroes(dev->priv, sector, count);
+}
+
+const struct blkdev_ops virtio_blkdev_ops = {
+    .read = virtio_blkdev_read,
+    .write = virtio_blkdev_write,
+    .flush = virtio_blkdev_flush,
+    .discard = virtio_blkdev_discard,
+    .write_zeroes = virtio_blkdev_write_zeroes,
+};
+
+/**
+ * @brief `blkdev_ops` of a device without write-zeroes: `blkdev_write_zeroes()` writes zeroed pages instead.
+ */
+const struct blkdev_ops virtio_blkdev_ops_no_write_zeroes = {
+    .read = virtio_blkdev_read,
+    .write = virtio_blkdev_write,
+    .flush = virtio_blkdev_flush,
+    .discard = virtio_blkdev_discard,
+    .write_zeroes = NULL,
+};
+
+/**
+ * @brief Initializes one block device.
+ *
+ * @param blk  The device's entry in the device table; `handle` is already set.
+ * @param slot The virtio-mmio slot the device sits in.
+ */
+void virtio_blk_probe(struct virtio_blk *blk, unsigned slot) {
+    paddr_t regs = VIRTIO_MMIO_PADDR(slot);
+    blk->regs = regs;
+    blk->irq = VIRTIO_MMIO_IRQ(slot);
+    INFO("virtio block %d: slot %d at 0x%x", blk->handle, slot, regs);
+
+    blk->version = virtio_reg_read32(regs, VIRTIO_REG_VERSION);
+    if (blk->version != 1 && blk->version != 2)
+        PANIC("virtio: invalid version %d", blk->version);
 
     // 1. Reset the device.
-    virtio_reg_write32(VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_RESET);
+    virtio_reg_write32(regs, VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_RESET);
 
     // 2. Guest OS has detected the device (Set the Acknowledgement bit).
-    virtio_reg_fetch_and_or32(VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACK);
+    virtio_reg_fetch_and_or32(regs, VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACK);
 
     // 2. Guest OS understands the device type (Set the DRIVER status bit).
-    virtio_reg_fetch_and_or32(VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_DRIVER);
+    virtio_reg_fetch_and_or32(regs, VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_DRIVER);
 
-    // 3. Feature negotiation is skipped; immediately accept.
-    virtio_reg_fetch_and_or32(VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FEAT_OK);
+    // 3. Negotiate features. The modern transport requires VIRTIO_F_VERSION_1,
+    // which a legacy device must not be offered; packed rings need it too.
+    uint64_t supported = VIRTIO_FEATURE(VIRTIO_RING_F_EVENT_IDX) | VIRTIO_FEATURE(VIRTIO_RING_F_INDIRECT_DESC) |
+                         VIRTIO_FEATURE(VIRTIO_BLK_F_FLUSH) | VIRTIO_FEATURE(VIRTIO_BLK_F_DISCARD) |
+                         VIRTIO_FEATURE(VIRTIO_BLK_F_WRITE_ZEROES) | VIRTIO_FEATURE(VIRTIO_BLK_F_MQ);
+    if (blk->version == 2)
+        supported |= VIRTIO_FEATURE(VIRTIO_F_VERSION_1) | VIRTIO_FEATURE(VIRTIO_F_RING_PACKED);
+    blk->features = virtio_negotiate_features(regs, supported);
+    if (blk->version == 2 && !(blk->features & VIRTIO_FEATURE(VIRTIO_F_VERSION_1)))
+        PANIC("virtio: device does not offer VIRTIO_F_VERSION_1");
 
-    // 5. Set up the first virtqueue (queue 0).
-    blk_request_vq = virtq_init(0);
+    // 4. Accept the features; a modern device clears FEATURES_OK again if it cannot work with them.
+    virtio_reg_fetch_and_or32(regs, VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FEAT_OK);
+    if (blk->version == 2 && !(virtio_reg_read32(regs, VIRTIO_REG_DEVICE_STATUS) & VIRTIO_STATUS_FEAT_OK))
+        PANIC("virtio: device rejected features");
+    INFO("virtio block %d: transport version %d, %s ring, event-idx %s, indirect descriptors %s", blk->handle,
+         blk->version, blk->features & VIRTIO_FEATURE(VIRTIO_F_RING_PACKED) ? "packed" : "split",
+         blk->features & VIRTIO_FEATURE(VIRTIO_RING_F_EVENT_IDX) ? "on" : "off",
+         blk->features & VIRTIO_FEATURE(VIRTIO_RING_F_INDIRECT_DESC) ? "on" : "off");
+
+    // 5. Set up a virtqueue per hart, as far as the device has them (queue 0 at least).
+    blk->num_queues = 1;
+    if (blk->features & VIRTIO_FEATURE(VIRTIO_BLK_F_MQ))
+        blk->num_queues = virtio_reg_read16(regs, VIRTIO_REG_DEVICE_CONFIG + VIRTIO_BLK_CONFIG_NUM_QUEUES);
+    if (blk->num_queues < 1)
+        blk->num_queues = 1;
+    if (blk->num_queues > VIRTIO_BLK_QUEUES_MAX)
+        blk->num_queues = VIRTIO_BLK_QUEUES_MAX;
+    for (unsigned q = 0; q < blk->num_queues; q++)
+        blk->vqs[q] = virtq_init(regs, blk->version, q, blk->features);
+    INFO("virtio block %d: %d request queue(s)", blk->handle, blk->num_queues);
 
     // 6. Driver is ready to use the device.
-    virtio_reg_write32(VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_DRIVER_OK);
+    virtio_reg_fetch_and_or32(regs, VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_DRIVER_OK);
 
-    // 7. Read block device capacity.
-    blk_capacity = virtio_reg_read64(VIRTIO_REG_DEVICE_CONFIG + 0) * SECTOR_SIZE;
-    INFO("virtio block: capacity is %d bytes", blk_capacity);
+    // 7. Read block device capacity and the limits of the optional commands.
+    blk->capacity = virtio_reg_read64(regs, VIRTIO_REG_DEVICE_CONFIG + VIRTIO_BLK_CONFIG_CAPACITY) * SECTOR_SIZE;
+    INFO("virtio block %d: capacity is %d bytes", blk->handle, blk->capacity);
+    if (blk->features & VIRTIO_FEATURE(VIRTIO_BLK_F_DISCARD))
+        blk->max_discard_sectors =
+            virtio_reg_read32(regs, VIRTIO_REG_DEVICE_CONFIG + VIRTIO_BLK_CONFIG_MAX_DISCARD_SECTORS);
+    if (blk->features & VIRTIO_FEATURE(VIRTIO_BLK_F_WRITE_ZEROES)) {
+        blk->max_write_zeroes_sectors =
+            virtio_reg_read32(regs, VIRTIO_REG_DEVICE_CONFIG + VIRTIO_BLK_CONFIG_MAX_WRITE_ZEROES_SECTORS);
+        blk->write_zeroes_unmap =
+            (virtio_reg_read32(regs, VIRTIO_REG_DEVICE_CONFIG + VIRTIO_BLK_CONFIG_WRITE_ZEROES_MAY_UNMAP) & 0xff) != 0;
+    }
+    INFO("virtio block %d: flush %s, discard %d sectors, write-zeroes %d sectors%s", blk->handle,
+         blk->features & VIRTIO_FEATURE(VIRTIO_BLK_F_FLUSH) ? "on" : "off", blk->max_discard_sectors,
+         blk->max_write_zeroes_sectors, blk->write_zeroes_unmap ? " (may unmap)" : "");
 
-    // 8. Allocate request buffer.
-    blk_req_paddr = alloc_pages(align_up(sizeof(*blk_req), PAGE_SIZE) / PAGE_SIZE);
-    blk_req = (struct virtio_blk_req *)blk_req_paddr;
+    // 8. Allocate the request pool and hand each queue its slots.
+    unsigned nreqs = VIRTIO_BLK_REQS_MAX * blk->num_queues;
+    blk->reqs = (struct blk_request *)alloc_pages(align_up(sizeof(struct blk_request) * nreqs, PAGE_SIZE) / PAGE_SIZE);
+    for (unsigned i = 0; i < nreqs; i++) {
+        blk->reqs[i].blk = blk;
+        blk->reqs[i].vq = blk->vqs[i / VIRTIO_BLK_REQS_MAX];
+        blk->reqs[i].id = i % VIRTIO_BLK_REQS_MAX;
+    }
+
+    // 9. Get an interrupt for every completed request.
+    plic_enable(blk->irq, 1);
 
-    OK("Initialized virtio block.");
+    // 10. Make the device available to the generic block layer.
+    strcpy(blk->name, "virtio");
+    itoa(blk->handle, blk->name + 6, 10);
+    blk->dev.name = blk->name;
+    blk->dev.ops = blk->max_write_zeroes_sectors ? &virtio_blkdev_ops : &virtio_blkdev_ops_no_write_zeroes;
+    blk->dev.priv = blk;
+    blk->dev.capacity = blk->capacity / SECTOR_SIZE;
+    blk->dev.queue_depth = VIRTIO_BLK_REQS_MAX * blk->num_queues;
+    blk->dev.counts_requests = true;
+    blkdev_register(&blk->dev);
 }
 
-void read_write_disk(void *buf, unsigned sector, bool is_write) {
-    if (sector >= blk_capacity / SECTOR_SIZE) {
-        FAILED("virtio block: tried to read/write sector=%d, but capacity is %d", sector, blk_capacity / SECTOR_SIZE);
-        return;
+void init_virtio_blk(void) {
+    INFO("Initializing virtio block...");
+
+    for (unsigned slot = 0; slot < VIRTIO_MMIO_SLOTS; slot++) {
+        paddr_t regs = VIRTIO_MMIO_PADDR(slot);
+        if (virtio_reg_read32(regs, VIRTIO_REG_MAGIC) != 0x74726976) {
+            FAILED("virtio: invalid magic value in slot %d", slot);
+            continue;
+        }
+
+        // Bind the device to its driver by device ID.
+        uint32_t device_id = virtio_reg_read32(regs, VIRTIO_REG_DEVICE_ID);
+        switch (device_id) {
+            case VIRTIO_DEVICE_NONE:
+                break;
+            case VIRTIO_DEVICE_BLK: {
+                struct virtio_blk *blk = &blk_devs[blk_num_devs];
+                blk->handle = blk_num_devs++;
+                virtio_blk_probe(blk, slot);
+                break;
+            }
+            default:
+                INFO("virtio: no driver for device id %d in slot %d", device_id, slot);
+        }
     }
+    if (blk_num_devs == 0)
+        PANIC("virtio: no block device");
+
+    OK("Initialized virtio block: %d device(s).", blk_num_devs);
+}
+
+struct virtio_blk *virtio_blk_get(unsigned handle) {
+    return handle < blk_num_devs ? &blk_devs[handle] : NULL;
+}
+
+unsigned virtio_blk_count(void) {
+    return blk_num_devs;
+}
 
-    // Construct the request according to the virtio-blk specification.
+/**
+ * @brief Returns the request queue of the calling hart.
+ *
+ * With fewer queues than harts, neighbouring harts share one.
+ *
+ * @param blk The device.
+ * @return The queue.
+ */
+struct virtio_virtq *blk_local_vq(struct virtio_blk *blk) {
+    return blk->vqs[cpu_id() % blk->num_queues];
+}
+
+/**
+ * @brief Number of ring descriptors a request takes.
+ *
+ * @param blk  The device.
+ * @param nseg Number of data segments.
+ * @return 1 with indirect descriptors, `nseg + 2` without.
+ */
+unsigned blk_request_descs(struct virtio_blk *blk, unsigned nseg) {
+    return blk->vqs[0]->indirect ? 1 : nseg + 2;
+}
+
+/**
+ * @brief Builds the descriptor chain of a request and submits it.
+ *
+ * Does not wait; the device processes the request while the caller goes on.
+ *
+ * @param r      A slot from `blk_alloc_request()` with `blk_request_descs()` descriptors available.
+ * @param type   Request type (`VIRTIO_BLK_T_*`). Only the data of `VIRTIO_BLK_T_IN` is written by the device.
+ * @param sector First sector to read/write (0 for other request types).
+ * @param segs   Physical data segments, in disk order.
+ * @param nseg   Number of data segments (0 for `VIRTIO_BLK_T_FLUSH`).
+ */
+void blk_submit(struct blk_request *r, uint32_t type, unsigned sector, const struct blk_seg *segs, unsigned nseg) {
+    // Construct the request according to the virtio-blk specification:
+    // a header, the data buffers and a status byte.
     //
     // struct virtio_blk_req {
     //     uint32_t type;
     //     uint32_t reserved;
     //     uint64_t sector;
-    //     uint8_t data[512];
-    //     uint8_t status;
     // } __attribute__((packed));
     //
-    blk_req->sector = sector;
-    blk_req->type = is_write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
-    if (is_write)
-        memcpy(blk_req->data, buf, SECTOR_SIZE);
+    r->req.sector = sector;
+    r->req.type = type;
+    r->status = 0xff;
+
+    struct virtq_desc chain[VIRTIO_BLK_INDIRECT_MAX];
+    unsigned n = nseg + 2;
 
-    // Construct the virtqueue descriptors (using 3 descriptors).
     // Descriptor 0: Header (type, reserved, sector)
-    struct virtio_virtq *vq = blk_request_vq;
-    vq->descs[0].addr = blk_req_paddr;
-    vq->descs[0].len = sizeof(uint32_t) * 2 + sizeof(uint64_t);  // uint32_t type, uint32_t reserved, uint36_t sector;
-    vq->descs[0].flags = VIRTQ_DESC_F_NEXT;
-    vq->descs[0].next = 1;
+    chain[0].addr = (paddr_t)&r->req;
+    chain[0].len = sizeof(struct virtio_blk_req);
+    chain[0].flags = VIRTQ_DESC_F_NEXT;
+
+    // Descriptors 1..nseg: Data buffers (read or write)
+    for (unsigned i = 0; i < nseg; i++) {
+        chain[i + 1].addr = segs[i].addr;
+        chain[i + 1].len = segs[i].len;
+        chain[i + 1].flags = VIRTQ_DESC_F_NEXT | (type == VIRTIO_BLK_T_IN ? VIRTQ_DESC_F_WRITE : 0);
+    }
+
+    // Last descriptor: Status byte (write-only for device)
+    chain[n - 1].addr = (paddr_t)&r->status;
+    chain[n - 1].len = sizeof(uint8_t);
+    chain[n - 1].flags = VIRTQ_DESC_F_WRITE;  // means you can write to this descriptor
+
+    // With indirect descriptors the chain goes into the request's own table,
+    // which then takes a single ring descriptor.
+    struct virtio_virtq *vq = r->vq;
+    uint16_t id = r->id;
+    if (vq->indirect) {
+        struct virtq_desc indirect = {
+            .addr = (paddr_t)r->indirect,
+            .len = virtq_write_indirect(vq, r->indirect, chain, n),
+            .flags = VIRTQ_DESC_F_INDIRECT,
+        };
+        virtq_add(vq, &indirect, 1, id);
+    } else {
+        virtq_add(vq, chain, n, id);
+    }
+    r->blk->inflight++;
+    blkdev_request_start(&r->blk->dev);
+}
 
-    // Descriptor 1: Data buffer (read or write)
-    vq->descs[1].addr = blk_req_paddr + offsetof(struct virtio_blk_req, data);
-    vq->descs[1].len = SECTOR_SIZE;  // uint8_t data[512];
-    vq->descs[1].flags = VIRTQ_DESC_F_NEXT | (is_write ? 0 : VIRTQ_DESC_F_WRITE);
-    vq->descs[1].next = 2;
+/**
+ * @brief Puts a read or write into its device's dispatch queue, in sector order.
+ *
+ * @param blk The device.
+ * @param r   The request, with `req`, `count` and `segs` filled in.
+ */
+void blk_sched_add(struct virtio_blk *blk, struct blk_request *r) {
+    struct blk_request **link = &blk->sched_queue;
+    while (*link && (*link)->req.sector <= r->req.sector)
+        link = &(*link)->next;
+    r->next = *link;
+    *link = r;
+    r->queued = true;
+    r->queued_at = get_time();
+}
 
-    vq->descs[2].addr = blk_req_paddr + offsetof(struct virtio_blk_req, status);
-    vq->descs[2].len = sizeof(uint8_t);       // uint8_t status;
-    vq->descs[2].flags = VIRTQ_DESC_F_WRITE;  // means you can write to this descriptor
+/**
+ * @brief Takes a request out of the dispatch queue without dispatching it.
+ *
+ * @param blk The device.
+ * @param r   A queued request.
+ */
+void blk_sched_remove(struct virtio_blk *blk, struct blk_request *r) {
+    struct blk_request **link = &blk->sched_queue;
+    while (*link != r)
+        link = &(*link)->next;
+    *link = r->next;
+    r->queued = false;
+}
 
-    // Descriptor 2: Status byte (write-only for device)
-    virtq_kick(vq, 0);
+/**
+ * @brief Returns the time at which the dispatch queue has to be emptied.
+ *
+ * @param blk The device.
+ * @return The arrival of the oldest queued request plus the window, or
+ *         `TIMER_NEVER` if the queue is empty.
+ */
+uint64_t blk_sched_due(struct virtio_blk *blk) {
+    uint64_t oldest = TIMER_NEVER;
+    for (struct blk_request *r = blk->sched_queue; r; r = r->next) {
+        if (r->queued_at < oldest)
+            oldest = r->queued_at;
+    }
+    return oldest == TIMER_NEVER ? TIMER_NEVER : oldest + ns_to_ticks(VIRTIO_BLK_SCHED_WINDOW_US * 1000);
+}
 
-    // Wait until the device finishes processing.
-    while (virtq_is_busy(vq));
+/**
+ * @brief Moves requests from the dispatch queue to the rings.
+ *
+ * Dispatches in elevator order: upwards from the sector after the last
+ * dispatched request, then around from the lowest sector. A request that has
+ * waited `VIRTIO_BLK_SCHED_DEADLINE_US` is dispatched first instead. Each
+ * request takes the queued requests that continue it (same direction, next
+ * sector) along in its descriptor chain, up to `VIRTIO_BLK_MERGE_SECTORS`
+ * and the segment budget. Stops when a ring runs out of descriptors; the
+ * rest goes once completions free some.
+ *
+ * @param blk The device.
+ */
+void blk_sched_dispatch(struct virtio_blk *blk) {
+    uint64_t now = get_time();
+    uint64_t deadline = ns_to_ticks(VIRTIO_BLK_SCHED_DEADLINE_US * 1000);
+    unsigned max = blk->vqs[0]->indirect ? VIRTIO_BLK_SG_MAX : VIRTQ_ENTRY_NUM - 2;
+    struct blk_sched_stats *stats = &blk->sched_stats;
+
+    while (blk->sched_queue) {
+        struct blk_request **link = NULL, **oldest = &blk->sched_queue;
+        for (struct blk_request **l = &blk->sched_queue; *l; l = &(*l)->next) {
+            if ((*l)->queued_at < (*oldest)->queued_at)
+                oldest = l;
+            if (!link && (*l)->req.sector >= blk->sched_head)
+                link = l;
+        }
+        bool expired = now - (*oldest)->queued_at >= deadline;
+        if (expired)
+            link = oldest;
+        else if (!link)
+            link = &blk->sched_queue;
+
+        // Collect the run of requests that continue the first one.
+        struct blk_request *first = *link, *last = first;
+        struct blk_seg segs[VIRTIO_BLK_SG_MAX];
+        unsigned nseg = 0, count = 0;
+        for (struct blk_request *r = first; r; r = r->next) {
+            if (r != first && (r->req.type != first->req.type || r->req.sector != first->req.sector + count ||
+                               count + r->count > VIRTIO_BLK_MERGE_SECTORS))
+                break;
+
+            // Buffers that continue each other physically share a segment.
+            bool joins = nseg > 0 && segs[nseg - 1].addr + segs[nseg - 1].len == r->segs[0].addr;
+            if (nseg + r->nseg - joins > max)
+                break;
+            for (unsigned i = 0; i < r->nseg; i++) {
+                if (i == 0 && joins)
+                    segs[nseg - 1].len += r->segs[0].len;
+                else
+                    segs[nseg++] = r->segs[i];
+            }
+            count += r->count;
+            last = r;
+        }
+        if (first->vq->num_free < blk_request_descs(blk, nseg))
+            break;
+
+        // Unlink the run; the requests after the first ride along with it.
+        *link = last->next;
+        first->merged = first != last ? first->next : NULL;
+        last->next = NULL;
+        for (struct blk_request *r = first; r; r = r == first ? first->merged : r->next) {
+            uint64_t residency = now - r->queued_at;
+            r->queued = false;
+            stats->residency += residency;
+            if (residency > stats->residency_max)
+                stats->residency_max = residency;
+            stats->ios++;
+        }
+        stats->requests++;
+        stats->expired += expired;
+
+        blk->sched_head = first->req.sector + count;
+        blk_submit(first, first->req.type, first->req.sector, segs, nseg);
+    }
+}
+
+/**
+ * @brief Dispatches the queued requests if it is time to.
+ *
+ * That is when the device has nothing to do, or when the oldest queued
+ * request has waited for the whole window.
+ *
+ * @param blk The device.
+ */
+void blk_sched_run(struct virtio_blk *blk) {
+    if (blk->sched_queue && (blk->inflight == 0 || get_time() >= blk_sched_due(blk)))
+        blk_sched_dispatch(blk);
+}
+
+/**
+ * @brief Waits for a device to make progress.
+ *
+ * Dispatches the queued requests if they are due, then sleeps on the device's
+ * wait queue until `virtio_blk_intr()` reports completed requests or the
+ * queue becomes due. The idle process must never block, so when it issues
+ * requests (during boot, e.g. from `init_fs()`) it polls the used rings instead.
+ *
+ * @param blk      The device.
+ * @param deadline Absolute time in `time` CSR ticks to give up at.
+ * @return False once `deadline` has passed.
+ */
+bool blk_wait_progress(struct virtio_blk *blk, uint64_t deadline) {
+    uint64_t now = get_time();
+    if (now >= deadline)
+        return false;
+
+    blk_sched_run(blk);
+    uint64_t due = blk_sched_due(blk);
+    if (due > now && due < deadline)
+        deadline = due;
+
+    if (get_current_process()->pid == 0) {
+        for (unsigned q = 0; q < blk->num_queues; q++)
+            virtq_process_used(blk, blk->vqs[q]);
+    } else
+        sleep_on_timeout(&blk->wq, deadline);
+    return true;
+}
+
+/**
+ * @brief Takes a slot from the request pool of the calling hart's queue.
+ *
+ * @param blk   The device.
+ * @param ndesc Number of descriptors the request needs; they must be free too.
+ * @param wait  If true, waits up to `VIRTIO_BLK_TIMEOUT_MS` for a slot and the descriptors.
+ * @return The slot, or NULL if none is available.
+ */
+struct blk_request *blk_alloc_request(struct virtio_blk *blk, unsigned ndesc, bool wait) {
+    uint64_t deadline = get_time() + ms_to_ticks(VIRTIO_BLK_TIMEOUT_MS);
+    struct virtio_virtq *vq = blk_local_vq(blk);
+    struct blk_request *slots = &blk->reqs[vq->queue_index * VIRTIO_BLK_REQS_MAX];
+
+    while (true) {
+        for (unsigned i = 0; i < VIRTIO_BLK_REQS_MAX && vq->num_free >= ndesc; i++) {
+            struct blk_request *r = &slots[i];
+            if (!r->in_use) {
+                r->in_use = true;
+                r->done = false;
+                r->abandoned = false;
+                r->bounce = 0;
+                r->queued = false;
+                r->merged = NULL;
+                return r;
+            }
+        }
+        if (!wait || !blk_wait_progress(blk, deadline))
+            return NULL;
+    }
+}
+
+bool blk_finish(struct blk_request *r) {
+    unsigned sector = r->req.sector;
+
+    // Wait until the device finishes processing, but do not hang forever on a dead device.
+    uint64_t deadline = get_time() + ms_to_ticks(VIRTIO_BLK_TIMEOUT_MS);
+    while (!r->done) {
+        if (!blk_wait_progress(r->blk, deadline)) {
+            if (r->queued) {
+                // Never dispatched: nothing refers to the slot once it leaves the queue.
+                blk_sched_remove(r->blk, r);
+                blk_release_bounce(r);
+                r->in_use = false;
+            } else if (r->bounce || (r->req.type != VIRTIO_BLK_T_IN && r->req.type != VIRTIO_BLK_T_OUT)) {
+                // The device still owns the chain, but it only points into the
+                // slot: the slot is recycled once the device returns it.
+                r->abandoned = true;
+            } else {
+                // The chain points straight at the caller's buffers, which
+                // must stay valid until the device is done with them.
+                FAILED("virtio block: type=%d sector=%d is overdue, waiting for the device", r->req.type, sector);
+                deadline = TIMER_NEVER;
+                continue;
+            }
+            FAILED("virtio block: timed out on type=%d sector=%d", r->req.type, sector);
+            return false;
+        }
+    }
 
     // Check request status. If a non-zero value is returned, it's an error.
-    if (blk_req->status != 0) {
-        FAILED("virtio block: failed to read/write sector=%d status=%d", sector, blk_req->status);
+    bool ok = r->status == 0;
+    if (!ok) {
+        FAILED("virtio block: request type=%d sector=%d failed, status=%d", r->req.type, sector, r->status);
+    } else if (r->bounce && r->req.type == VIRTIO_BLK_T_IN) {
+        // A bounced read lands in the bounce buffer: hand it out to the caller's buffers.
+        uint8_t *src = (uint8_t *)r->bounce;
+        for (unsigned i = 0; i < r->nsg; i++) {
+            memcpy(r->sg[i].addr, src, r->sg[i].len);
+            src += r->sg[i].len;
+        }
+    }
+
+    blk_release_bounce(r);
+    r->in_use = false;
+    wake_up(&r->blk->wq);  // Let a caller waiting for a slot issue its request.
+    return ok;
+}
+
+/**
+ * @brief Translates a scatter-gather list into physically contiguous segments.
+ *
+ * Kernel memory is identity-mapped, so a kernel buffer is a single segment.
+ * Other buffers are user memory: they are translated page by page through the
+ * active page table, and neighbouring pages that are also physically adjacent
+ * are merged. The device accesses them on the process's behalf, so each page
+ * must be user-accessible, and writable if the device writes to it; this keeps
+ * a process from having the device overwrite the read-only vvar page or
+ * anything else it cannot write itself. System calls reject user pointers into
+ * the kernel range before they get here.
+ *
+ * @param sg       The caller's buffers.
+ * @param nsg      Number of entries of `sg`.
+ * @param segs     Receives up to `max` segments.
+ * @param max      Maximum number of segments, at most `VIRTIO_BLK_SG_MAX`.
+ * @param to_buf   The device writes to the buffers (`VIRTIO_BLK_T_IN`).
+ * @return The number of segments; 0 if they do not fit in `max`;
+ *         -1 if part of a buffer is not mapped with the required permissions.
+ */
+int blk_map_sg(const struct blk_sg *sg, unsigned nsg, struct blk_seg *segs, unsigned max, bool to_buf) {
+    // Before paging is enabled (during boot) every address is physical.
+    uint32_t satp = READ_CSR(satp);
+    uint32_t *table1 = (uint32_t *)((satp & SATP_PPN_MASK) * PAGE_SIZE);
+    bool paging = (satp & SATP_SV32) != 0;
+    uint32_t flags = PAGE_U | (to_buf ? PAGE_W : 0);
+    unsigned nseg = 0;
+    bool fits = true;
+
+    for (unsigned i = 0; i < nsg; i++) {
+        vaddr_t vaddr = (vaddr_t)sg[i].addr;
+        uint32_t left = sg[i].len;
+
+        while (left > 0) {
+            paddr_t paddr;
+            uint32_t len;
+            if (!paging || (vaddr >= (vaddr_t)__kernel_base && vaddr + left <= (vaddr_t)__free_ram_end)) {
+                paddr = vaddr;
+                len = left;
+            } else {
+                paddr = virt_to_phys(table1, vaddr, flags);
+                if (!paddr)
+                    return -1;
+                len = PAGE_SIZE - (vaddr & (PAGE_SIZE - 1));
+                if (len > left)
+                    len = left;
+            }
+
+            if (nseg > 0 && segs[nseg - 1].addr + segs[nseg - 1].len == paddr) {
+                segs[nseg - 1].len += len;
+            } else if (nseg == max) {
+                // Keep walking: a bounced buffer must pass the checks too.
+                fits = false;
+            } else {
+                segs[nseg].addr = paddr;
+                segs[nseg].len = len;
+                nseg++;
+            }
+            vaddr += len;
+            left -= len;
+        }
+    }
+    return fits ? (int)nseg : 0;
+}
+
+struct blk_request *blk_start(struct virtio_blk *blk, unsigned sector, const struct blk_sg *sg, unsigned nsg,
+                              uint32_t len, bool is_write, bool wait) {
+    struct blk_seg segs[VIRTIO_BLK_SG_MAX];
+    // Without indirect descriptors the chain has to fit in the ring itself.
+    unsigned max = blk->vqs[0]->indirect ? VIRTIO_BLK_SG_MAX : VIRTQ_ENTRY_NUM - 2;
+    int nseg = blk_map_sg(sg, nsg, segs, max, !is_write);
+    if (nseg < 0) {
+        FAILED("virtio block: buffer for sector=%d is not accessible", sector);
+        return NULL;
+    }
+
+    struct blk_request *r = blk_alloc_request(blk, blk_request_descs(blk, nseg ? nseg : 1), wait);
+    if (!r)
+        return NULL;
+
+    if (nseg == 0) {
+        if (len > VIRTIO_BLK_BOUNCE_SIZE) {
+            FAILED("virtio block: %d bytes at sector=%d are too fragmented to transfer", len, sector);
+            r->in_use = false;
+            return NULL;
+        }
+        if (!r->bounce_buf)
+            r->bounce_buf = alloc_pages(VIRTIO_BLK_BOUNCE_SIZE / PAGE_SIZE);
+        r->bounce = r->bounce_buf;
+        r->sg = sg;
+        r->nsg = nsg;
+        if (is_write) {
+            uint8_t *dst = (uint8_t *)r->bounce;
+            for (unsigned i = 0; i < nsg; i++) {
+                memcpy(dst, sg[i].addr, sg[i].len);
+                dst += sg[i].len;
+            }
+        }
+        segs[0].addr = r->bounce;
+        segs[0].len = len;
+        nseg = 1;
+    }
+
+    r->req.type = is_write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    r->req.sector = sector;
+    r->count = len / SECTOR_SIZE;
+    memcpy(r->segs, segs, nseg * sizeof(segs[0]));
+    r->nseg = nseg;
+    blk_sched_add(blk, r);
+    blk_sched_run(blk);
+    return r;
+}
+
+bool read_write_disk_sg(struct virtio_blk *blk, unsigned sector, const struct blk_sg *sg, unsigned nsg, bool is_write) {
+    uint32_t len = 0;
+    for (unsigned i = 0; i < nsg; i++)
+        len += sg[i].len;
+
+    if (len == 0 || len % SECTOR_SIZE != 0) {
+        FAILED("virtio block: invalid scatter-gather list (%d buffers, %d bytes)", nsg, len);
+        return false;
+    }
+    struct blk_request *r = blk_start(blk, sector, sg, nsg, len, is_write, true);
+    if (!r) {
+        FAILED("virtio block: could not issue request for sector=%d", sector);
+        return false;
+    }
+    return blk_finish(r);
+}
+
+void read_write_disk(struct virtio_blk *blk, void *buf, unsigned sector, bool is_write) {
+    struct blk_sg sg = {.addr = buf, .len = SECTOR_SIZE};
+    read_write_disk_sg(blk, sector, &sg, 1, is_write);
+}
+
+bool blk_read_write_pieces(blk_piece_fn_t next, void *ctx, void *buf, unsigned count, bool is_write,
+                           struct blkdev *via) {
+    // Pieces in flight in submission order; results are collected oldest first.
+    // Their buffer lists must outlive the requests, so they are kept alongside.
+    struct blk_request *inflight[VIRTIO_BLK_REQS_MAX];
+    struct blk_sg sgs[VIRTIO_BLK_REQS_MAX];
+    uint64_t started[VIRTIO_BLK_REQS_MAX];
+    unsigned submitted = 0, finished = 0, done = 0;
+    uint8_t *data = (uint8_t *)buf;
+    bool ok = true;
+
+    while (done < count || finished < submitted) {
+        if (done < count && submitted - finished < VIRTIO_BLK_REQS_MAX) {
+            struct blk_piece piece;
+            next(ctx, done, count - done, &piece);
+
+            // Only block for a slot with nothing of our own in flight: our
+            // finished pieces hold their slots until we collect them.
+            bool idle = submitted == finished;
+            struct blk_sg *sg = &sgs[submitted % VIRTIO_BLK_REQS_MAX];
+            sg->addr = &data[done * SECTOR_SIZE];
+            sg->len = piece.count * SECTOR_SIZE;
+
+            uint64_t now = get_time();
+            struct blk_request *r = blk_start(piece.blk, piece.sector, sg, 1, sg->len, is_write, idle);
+            if (r) {
+                if (via)
+                    blkdev_request_start(via);
+                inflight[submitted % VIRTIO_BLK_REQS_MAX] = r;
+                started[submitted % VIRTIO_BLK_REQS_MAX] = now;
+                submitted++;
+                done += piece.count;
+                continue;
+            }
+            if (idle) {
+                FAILED("%s: could not issue request for sector=%d", piece.blk->name, piece.sector);
+                return false;
+            }
+        }
+
+        struct blk_request *r = inflight[finished % VIRTIO_BLK_REQS_MAX];
+        struct virtio_blk *blk = r->blk;
+        unsigned n = r->count;
+        bool piece_ok = blk_finish(r);
+        if (via) {
+            blkdev_request_end(via);
+            blkdev_account(&blk->dev, is_write ? IOSTAT_WRITE : IOSTAT_READ, n,
+                           started[finished % VIRTIO_BLK_REQS_MAX], piece_ok);
+        }
+        ok &= piece_ok;
+        finished++;
+    }
+    return ok;
+}
+
+/**
+ * @brief Context of `read_write_disk_range()`: the device and the first sector.
+ */
+struct blk_range {
+    struct virtio_blk *blk;
+    unsigned sector;
+};
+
+/**
+ * @brief `blk_piece_fn_t` of `read_write_disk_range()`: requests of `VIRTIO_BLK_RANGE_SECTORS`.
+ */
+void blk_range_piece(void *ctx, unsigned done, unsigned left, struct blk_piece *piece) {
+    struct blk_range *range = ctx;
+    piece->blk = range->blk;
+    piece->sector = range->sector + done;
+    piece->count = left < VIRTIO_BLK_RANGE_SECTORS ? left : VIRTIO_BLK_RANGE_SECTORS;
+}
+
+bool read_write_disk_range(struct virtio_blk *blk, void *buf, unsigned sector, unsigned count, bool is_write) {
+    struct blk_range range = {.blk = blk, .sector = sector};
+    return blk_read_write_pieces(blk_range_piece, &range, buf, count, is_write, NULL);
+}
+
+/**
+ * @brief Issues a request that carries no caller data and waits for it.
+ *
+ * @param blk    The device.
+ * @param type   `VIRTIO_BLK_T_FLUSH`, `VIRTIO_BLK_T_DISCARD` or `VIRTIO_BLK_T_WRITE_ZEROES`.
+ * @param sector First sector of the range (discard and write-zeroes).
+ * @param count  Number of sectors of the range (discard and write-zeroes).
+ * @param flags  `virtio_blk_discard_write_zeroes::flags`.
+ * @return True on success.
+ */
+bool blk_command(struct virtio_blk *blk, uint32_t type, unsigned sector, unsigned count, uint32_t flags) {
+    struct blk_request *r = blk_alloc_request(blk, blk_request_descs(blk, 1), true);
+    if (!r) {
+        FAILED("virtio block: could not issue request type=%d", type);
+        return false;
+    }
+
+    // A flush is just the header and the status; the other two carry the
+    // range as their (device-readable) data.
+    struct blk_seg seg = {.addr = (paddr_t)&r->range, .len = sizeof(r->range)};
+    r->range.sector = sector;
+    r->range.num_sectors = count;
+    r->range.flags = flags;
+    blk_submit(r, type, 0, &seg, type == VIRTIO_BLK_T_FLUSH ? 0 : 1);
+    return blk_finish(r);
+}
+
+bool blk_flush(struct virtio_blk *blk) {
+    if (!(blk->features & VIRTIO_FEATURE(VIRTIO_BLK_F_FLUSH)))
+        return true;
+    return blk_command(blk, VIRTIO_BLK_T_FLUSH, 0, 0, 0);
+}
+
+bool blk_discard(struct virtio_blk *blk, unsigned sector, unsigned count) {
+    if (!(blk->features & VIRTIO_FEATURE(VIRTIO_BLK_F_DISCARD)) || !blk->max_discard_sectors)
+        return true;
+
+    while (count > 0) {
+        unsigned n = count < blk->max_discard_sectors ? count : blk->max_discard_sectors;
+        if (!blk_command(blk, VIRTIO_BLK_T_DISCARD, sector, n, 0))
+            return false;
+        sector += n;
+        count -= n;
+    }
+    return true;
+}
+
+bool blk_write_zeroes(struct virtio_blk *blk, unsigned sector, unsigned count) {
+    uint32_t flags = blk->write_zeroes_unmap ? VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP : 0;
+    while (count > 0) {
+        unsigned n = count < blk->max_write_zeroes_sectors ? count : blk->max_write_zeroes_sectors;
+        if (!blk_command(blk, VIRTIO_BLK_T_WRITE_ZEROES, sector, n, flags))
+            return false;
+        sector += n;
+        count -= n;
+    }
+    return true;
+}
+
+void virtio_blk_report(void) {
+    for (unsigned i = 0; i < blk_num_devs; i++) {
+        struct virtio_blk *blk = &blk_devs[i];
+        struct blk_sched_stats *stats = &blk->sched_stats;
+        if (!stats->requests)
+            continue;
+
+        unsigned ratio = stats->ios * 10 / stats->requests;
+        unsigned avg_us = ticks_to_ns(stats->residency / stats->ios) / 1000;
+        unsigned max_us = ticks_to_ns(stats->residency_max) / 1000;
+        INFO("%s: %d reads/writes in %d requests (merge ratio %d.%d, %d on deadline), queue residency avg=%dus max=%dus",
+             blk->name, stats->ios, stats->requests, ratio / 10, ratio % 10, stats->expired, avg_us, max_us);
+    }
+}
+
+void virtio_blk_intr(uint32_t irq) {
+    struct virtio_blk *blk = NULL;
+    for (unsigned i = 0; i < blk_num_devs; i++) {
+        if (blk_devs[i].irq == irq)
+            blk = &blk_devs[i];
+    }
+    if (!blk) {
+        FAILED("virtio: unexpected irq=%d", irq);
         return;
     }
 
-    // For read operations, copy data from the request into the caller's buffer.
-    if (!is_write)
-        memcpy(buf, blk_req->data, SECTOR_SIZE);
+    uint32_t status = virtio_reg_read32(blk->regs, VIRTIO_REG_INTERRUPT_STATUS);
+    virtio_reg_write32(blk->regs, VIRTIO_REG_INTERRUPT_ACK, status);
+
+    // All queues share the device's interrupt.
+    bool progress = false;
+    for (unsigned q = 0; q < blk->num_queues; q++)
+        progress |= virtq_process_used(blk, blk->vqs[q]);
+    if (progress) {
+        // Keep the device busy with what queued up meanwhile, even if its
+        // issuers are waiting on another device.
+        blk_sched_run(blk);
+        wake_up(&blk->wq);
+    }
 }
@@ -81,3 +81,17 @@ void map_page(uint32_t *table1, uint32_t vaddr, paddr_t paddr, uint32_t flags) {
     // Each PTE is of size 4 Bytes
     table0[vpn0] = ((paddr / PAGE_SIZE) << 10) | flags | PAGE_V;
 }
+
+paddr_t virt_to_phys(uint32_t *table1, uint32_t vaddr, uint32_t flags) {
+    uint32_t vpn1 = (vaddr >> 22) & 0x3ff;
+    uint32_t vpn0 = (vaddr >> 12) & 0x3ff;
+
+    if ((table1[vpn1] & PAGE_V) == 0)
+        return 0;
+
+    uint32_t *table0 = (uint32_t *)((table1[vpn1] >> 10) * PAGE_SIZE);
+    if ((table0[vpn0] & (PAGE_V | flags)) != (PAGE_V | flags))
+        return 0;
+
+    return (table0[vpn0] >> 10) * PAGE_SIZE + (vaddr & (PAGE_SIZE - 1));
+}
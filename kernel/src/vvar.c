@@ -0,0 +1,35 @@
+#include "vvar.h"
+
+#include "alloc.h"
+#include "clock.h"
+#include "lib.h"
+#include "types.h"
+#include "utils.h"
+#include "vdso.h"
+#include "vm.h"
+
+struct vdso_data *vvar;
+
+void init_vvar(void) {
+    INFO("Initializing vDSO data page...");
+    vvar = (struct vdso_data *)alloc_pages(1);
+    vvar->timebase_freq = timebase_freq;
+    OK("Initialized vDSO data page.");
+}
+
+struct vdso_proc *map_vvar(uint32_t *page_table, int32_t pid) {
+    struct vdso_proc *proc = (struct vdso_proc *)alloc_pages(1);
+    proc->pid = pid;
+
+    map_page(page_table, VDSO_VADDR, (paddr_t)vvar, PAGE_U | PAGE_R);
+    map_page(page_table, VDSO_PROC_VADDR, (paddr_t)proc, PAGE_U | PAGE_R);
+    return proc;
+}
+
+void vvar_count(uint64_t *counter) {
+    vvar->seq++;
+    __sync_synchronize();  // Readers must see the odd count before the update...
+    (*counter)++;
+    __sync_synchronize();  // ...and the update before the even count.
+    vvar->seq++;
+}
@@ -0,0 +1,110 @@
+#include "wait.h"
+
+#include "clock.h"
+#include "lib.h"
+#include "proc.h"
+#include "timer.h"
+#include "types.h"
+
+void sleep_on(struct wait_queue *wq) {
+    struct process *proc = get_current_process();
+
+    proc->state = PROC_BLOCKED;
+    proc->wait_queue = wq;
+    proc->wait_next = NULL;
+    if (wq->tail)
+        wq->tail->wait_next = proc;
+    else
+        wq->head = proc;
+    wq->tail = proc;
+
+    // We are no longer runnable, so this only returns after a wake_up().
+    yield();
+}
+
+/**
+ * @brief Removes a process from the middle of a wait queue.
+ *
+ * @param wq   The wait queue.
+ * @param proc A process queued on `wq`.
+ */
+void wait_queue_remove(struct wait_queue *wq, struct process *proc) {
+    struct process *prev = NULL;
+    for (struct process *p = wq->head; p; prev = p, p = p->wait_next) {
+        if (p != proc)
+            continue;
+
+        if (prev)
+            prev->wait_next = proc->wait_next;
+        else
+            wq->head = proc->wait_next;
+        if (wq->tail == proc)
+            wq->tail = prev;
+        break;
+    }
+    proc->wait_next = NULL;
+    proc->wait_queue = NULL;
+}
+
+/**
+ * @brief Timer callback ending a `sleep_on_timeout()`.
+ *
+ * @param t The `wait_timer` of the sleeping process.
+ */
+void wait_timeout(struct timer *t) {
+    struct process *proc = (struct process *)t->arg;
+    if (proc->state != PROC_BLOCKED)
+        return;
+
+    if (proc->wait_queue)
+        wait_queue_remove(proc->wait_queue, proc);
+    proc->timed_out = true;
+    proc->state = PROC_RUNNABLE;
+}
+
+bool sleep_on_timeout(struct wait_queue *wq, uint64_t deadline) {
+    struct process *proc = get_current_process();
+
+    if (deadline <= get_time())
+        return false;
+
+    proc->timed_out = false;
+    if (deadline != TIMER_NEVER) {
+        proc->wait_timer.callback = wait_timeout;
+        proc->wait_timer.arg = proc;
+        timer_add(&proc->wait_timer, deadline);
+    }
+
+    if (wq) {
+        sleep_on(wq);
+    } else {
+        proc->state = PROC_BLOCKED;
+        yield();
+    }
+
+    timer_cancel(&proc->wait_timer);
+    return !proc->timed_out;
+}
+
+bool wake_up_one(struct wait_queue *wq) {
+    struct process *proc = wq->head;
+    if (!proc)
+        return false;
+
+    wq->head = proc->wait_next;
+    if (!wq->head)
+        wq->tail = NULL;
+
+    proc->wait_next = NULL;
+    proc->wait_queue = NULL;
+    proc->state = PROC_RUNNABLE;
+
+    // The woken process may now compete for the CPU: resume the tick if needed.
+    timer_reprogram();
+    return true;
+}
+
+void wake_up(struct wait_queue *wq) {
+    while (wake_up_one(wq))
+        ;
+}
@@ -0,0 +1,79 @@
+#include "workqueue.h"
+
+#include "lib.h"
+#include "proc.h"
+#include "types.h"
+#include "utils.h"
+#include "wait.h"
+
+/**
+ * @brief Work queued for the kernel worker thread, oldest first.
+ */
+struct work *work_head;
+struct work *work_tail;
+
+/**
+ * @brief The work item the worker is running right now, or NULL.
+ */
+struct work *work_running;
+
+/**
+ * @brief Wait queues of the worker (waiting for work) and of `flush_work()` callers.
+ */
+struct wait_queue worker_wq;
+struct wait_queue work_done_wq;
+
+/**
+ * @brief Main loop of the kernel worker thread.
+ *
+ * Runs queued work items one after another and sleeps while the queue is empty.
+ *
+ * @param arg Unused.
+ */
+void worker_main(void *arg) {
+    (void)arg;
+
+    for (;;) {
+        while (!work_head)
+            sleep_on(&worker_wq);
+
+        struct work *w = work_head;
+        work_head = w->next;
+        if (!work_head)
+            work_tail = NULL;
+
+        w->pending = false;
+        work_running = w;
+        w->fn(w);
+        work_running = NULL;
+
+        wake_up(&work_done_wq);
+    }
+}
+
+void init_workqueue(void) {
+    INFO("Initializing kernel worker...");
+    struct process *worker = create_kthread(worker_main, NULL);
+    OK("Initialized kernel worker: pid=%d.", worker->pid);
+}
+
+bool queue_work(struct work *w) {
+    if (w->pending)
+        return false;
+
+    w->pending = true;
+    w->next = NULL;
+    if (work_tail)
+        work_tail->next = w;
+    else
+        work_head = w;
+    work_tail = w;
+
+    wake_up_one(&worker_wq);
+    return true;
+}
+
+void flush_work(struct work *w) {
+    while (w->pending || work_running == w)
+        sleep_on(&work_done_wq);
+}
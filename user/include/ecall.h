@@ -1,25 +1,70 @@
 #pragma once
+#include "errno.h"
+#include "stat.h"
+#include "sys.h"
 #include "types.h"
 
 /**
- * @brief Performs a system call with up to three arguments.
+ * @brief Performs a system call with up to six arguments.
  *
  * This function sets up the appropriate registers and executes the `ecall`
  * instruction to transition from user mode to supervisor mode, invoking
  * a system call identified by `sysno`.
  *
- * @param sysno The system call number (placed in register a3).
+ * @param sysno The system call number (placed in register a7).
  * @param arg0  First argument to the syscall (passed in register a0).
  * @param arg1  Second argument to the syscall (passed in register a1).
  * @param arg2  Third argument to the syscall (passed in register a2).
+ * @param arg3  Fourth argument to the syscall (passed in register a3).
+ * @param arg4  Fifth argument to the syscall (passed in register a4).
+ * @param arg5  Sixth argument to the syscall (passed in register a5).
  *
- * @return The result of the system call, returned in register a0.
+ * @return The result of the system call, returned in register a0. Negative
+ * values are negated error numbers (see `errno.h`).
  *
  * @note This function uses inline assembly to perform the syscall on a RISC-V
  * architecture. It clobbers memory to prevent the compiler from reordering
  * memory accesses around the syscall.
  */
-int32_t syscall(int32_t sysno, int32_t arg0, int32_t arg1, int32_t arg2);
+int32_t syscall(int32_t sysno, int32_t arg0, int32_t arg1, int32_t arg2,
+                int32_t arg3, int32_t arg4, int32_t arg5);
+
+/**
+ * @brief Parameter and argument lists of the raw system call stubs, by argument count.
+ */
+#define SYSCALL_PARAMS_0 void
+#define SYSCALL_PARAMS_1 int32_t a0
+#define SYSCALL_PARAMS_2 int32_t a0, int32_t a1
+#define SYSCALL_PARAMS_3 int32_t a0, int32_t a1, int32_t a2
+#define SYSCALL_PARAMS_4 int32_t a0, int32_t a1, int32_t a2, int32_t a3
+#define SYSCALL_PARAMS_5 int32_t a0, int32_t a1, int32_t a2, int32_t a3, int32_t a4
+#define SYSCALL_PARAMS_6 int32_t a0, int32_t a1, int32_t a2, int32_t a3, int32_t a4, int32_t a5
+#define SYSCALL_ARGS_0 0, 0, 0, 0, 0, 0
+#define SYSCALL_ARGS_1 a0, 0, 0, 0, 0, 0
+#define SYSCALL_ARGS_2 a0, a1, 0, 0, 0, 0
+#define SYSCALL_ARGS_3 a0, a1, a2, 0, 0, 0
+#define SYSCALL_ARGS_4 a0, a1, a2, a3, 0, 0
+#define SYSCALL_ARGS_5 a0, a1, a2, a3, a4, 0
+#define SYSCALL_ARGS_6 a0, a1, a2, a3, a4, a5
+
+/**
+ * @brief Raw system call stubs, generated from `SYSCALLS` in `sys.h`.
+ *
+ * For every system call there is a stub `syscall_<name>()` taking exactly as
+ * many register-sized arguments as the kernel handler reads. The typed wrappers
+ * below are built on top of them.
+ *
+ * @example
+ * @code
+ * int32_t ret = syscall_readfile((int32_t)"hello.txt", (int32_t)buf, sizeof(buf));
+ * @endcode
+ */
+#define DECLARE_SYSCALL_STUB(nr, name, nargs) int32_t syscall_##name(SYSCALL_PARAMS_##nargs);
+#define DEFINE_SYSCALL_STUB(nr, name, nargs)         \
+    int32_t syscall_##name(SYSCALL_PARAMS_##nargs) { \
+        return syscall(nr, SYSCALL_ARGS_##nargs);    \
+    }
+SYSCALLS(DECLARE_SYSCALL_STUB)
 
 /**
  * @brief Writes a single character to the console output.
@@ -41,6 +86,15 @@ void putchar(char ch);
  */
 int32_t getchar(void);
 
+/**
+ * @brief Reads a single character from the console input, giving up after a timeout.
+ *
+ * @param timeout_ms Maximum time to wait in milliseconds (0 waits forever).
+ *
+ * @return The character read, or `-ETIMEDOUT` if no character arrived in time.
+ */
+int32_t getchar_timeout(int32_t timeout_ms);
+
 /**
  * @brief Reads data from a file into a buffer.
  *
@@ -51,7 +105,7 @@ int32_t getchar(void);
  * @param buf      Pointer to the buffer where data will be stored.
  * @param len      Maximum number of bytes to read.
  *
- * @return Number of bytes read on success, or -1 if the file was not found.
+ * @return Number of bytes read on success, or `-ENOENT` if the file was not found.
  */
 int32_t readfile(const char *filename, char *buf, int32_t len);
 
@@ -66,7 +120,7 @@ int32_t readfile(const char *filename, char *buf, int32_t len);
  * @param buf      Pointer to the buffer containing data to write.
  * @param len      Number of bytes to write.
  *
- * @return Number of bytes written on success, or -1 if the file was not found.
+ * @return Number of bytes written on success, or `-ENOENT` if the file was not found.
  */
 int32_t writefile(const char *filename, const char *buf, int32_t len);
 
@@ -76,3 +130,117 @@ int32_t writefile(const char *filename, const char *buf, int32_t len);
  * This function performs a system call to power off the machine.
  */
 void shutdown(void);
+
+/**
+ * @brief Reads the page cache statistics of every hart.
+ *
+ * This function performs a system call that fills one `struct pagestat` per
+ * hart, indexed by hart ID.
+ *
+ * @param stats Buffer to fill, one entry per hart.
+ * @param n     Number of entries `stats` can hold.
+ *
+ * @return The number of entries written.
+ */
+int32_t pagestat(struct pagestat *stats, int32_t n);
+
+/**
+ * @brief Suspends the calling process.
+ *
+ * This function performs a system call that blocks the process until the given
+ * time has passed. No CPU time is used while sleeping.
+ *
+ * @param ns    Duration in nanoseconds, or an absolute `clock_gettime()` time (see `vsyscall.h`)
+ *              if `flags` contains `TIMER_ABSTIME`.
+ * @param flags 0 or `TIMER_ABSTIME`.
+ *
+ * @return 0.
+ *
+ * @example
+ * @code
+ * uint64_t next = clock_gettime();
+ * while (true) {
+ *     next += 100 * 1000000;  // Every 100 ms, without drift.
+ *     nanosleep(next, TIMER_ABSTIME);
+ * }
+ * @endcode
+ */
+int32_t nanosleep(uint64_t ns, int32_t flags);
+
+/**
+ * @brief Suspends the calling process for a number of milliseconds.
+ *
+ * @param ms Duration in milliseconds.
+ */
+void sleep(uint32_t ms);
+
+/**
+ * @brief Reads the scheduler statistics of every process.
+ *
+ * This function performs a system call that fills one `struct procstat` per
+ * process (including kernel threads and the idle process) in a single trap.
+ *
+ * @param stats Buffer to fill, one entry per process.
+ * @param n     Number of entries `stats` can hold.
+ *
+ * @return The number of entries written.
+ */
+int32_t procstat(struct procstat *stats, int32_t n);
+
+/**
+ * @brief Starts an embedded user program as a child process.
+ *
+ * @param name Name of the program (`"shell"` or `"bench"`).
+ * @param arg  Argument the child reads with `getarg()`.
+ *
+ * @return Process ID of the child, `-ENOENT` if there is no such program, or
+ * `-EAGAIN` if the process table is full.
+ */
+int32_t spawn(const char *name, int32_t arg);
+
+/**
+ * @brief Waits for a child process to exit.
+ *
+ * @param pid Process ID returned by `spawn()`.
+ *
+ * @return 0 once the child has exited, or `-ECHILD` if `pid` is not a child.
+ */
+int32_t wait(int32_t pid);
+
+/**
+ * @brief Gives up the CPU to another runnable process, if there is one.
+ */
+void sched_yield(void);
+
+/**
+ * @brief Reads raw sectors of a block device.
+ *
+ * Bypasses the file system; disks transfer straight into `buf`.
+ *
+ * @param dev    Handle of the device, in the order the kernel registers them:
+ *               0 for the primary disk, then one per further disk in
+ *               virtio-mmio slot order. With two or more scratch disks, the
+ *               next handle is the stripe over all scratch disks. The RAM
+ *               disk, if the kernel has one, comes last.
+ * @param sector First sector (512 bytes each).
+ * @param buf    Writable buffer of `count * 512` bytes.
+ * @param count  Number of sectors, 1 to 128.
+ *
+ * @return The number of bytes read, `-ENODEV` for a bad handle, `-EINVAL` for a bad count, `-EFAULT` if
+ * `buf` is not user memory, or `-EIO` if the device failed, the sectors are beyond its end or `buf` is
+ * not writable.
+ */
+int32_t diskread(uint32_t dev, uint32_t sector, void *buf, uint32_t count);
+
+/**
+ * @brief Reads the I/O statistics of every block device.
+ *
+ * This function performs a system call that fills one `struct iostat` per
+ * block device, in `diskread()` handle order.
+ *
+ * @param stats Buffer to fill, one entry per device.
+ * @param n     Number of entries `stats` can hold.
+ *
+ * @return The number of entries written.
+ */
+int32_t iostat(struct iostat *stats, int32_t n);
@@ -0,0 +1,39 @@
+#pragma once
+#include "ioring.h"
+#include "types.h"
+
+/**
+ * @brief Maps the submission/completion rings of the calling process.
+ *
+ * @return The shared rings, or NULL if they could not be set up.
+ */
+struct ioring *ring_setup(void);
+
+/**
+ * @brief Queues one operation on the submission queue.
+ *
+ * The operation is only executed by the next `ring_submit()`.
+ *
+ * @param r   The rings.
+ * @param sqe The operation; copied into the queue.
+ * @return False if the submission queue is full.
+ */
+bool ring_queue(struct ioring *r, const struct ring_sqe *sqe);
+
+/**
+ * @brief Executes all queued operations with a single system call.
+ *
+ * @param r            The rings.
+ * @param min_complete Number of completions to wait for before returning.
+ * @return The number of operations consumed, or a negated error number.
+ */
+int32_t ring_submit(struct ioring *r, uint32_t min_complete);
+
+/**
+ * @brief Takes the oldest completion off the completion queue.
+ *
+ * @param r   The rings.
+ * @param cqe Receives the completion.
+ * @return False if no completion is queued.
+ */
+bool ring_peek(struct ioring *r, struct ring_cqe *cqe);
@@ -9,6 +9,14 @@
  * - `hello`      : Prints a hello message from the shell.
  * - `readfile`   : Reads and prints the contents of "hello.txt".
  * - `writefile`  : Writes a predefined message to "hello.txt".
+ * - `pagestat`   : Prints the page cache hit rate of every active hart.
+ * - `top`        : Prints the CPU share, CPU time and context switches of every process over one second.
+ * - `iostat`     : Prints the I/O counters and the read, write and flush latency histograms of every block device.
+ * - `sleep`      : Sleeps for one second and prints the time actually slept.
+ * - `nullbench`  : Measures the average cost of an empty system call in cycles.
+ * - `ring`       : Writes to the console, reads "hello.txt" and waits 100 ms through the shared rings.
+ * - `vdso`       : Prints the pid, uptime and system counters read from the vDSO pages.
+ * - `bench`      : Runs the benchmark suite (see `bench.h`) and waits for it to finish.
  * - `shutdown`   : Shuts down the system.
  * - `exit`       : Exits the shell process.
  *
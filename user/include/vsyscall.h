@@ -0,0 +1,40 @@
+#pragma once
+#include "types.h"
+#include "vdso.h"
+
+/**
+ * @brief Helpers that read the kernel data pages mapped into every process
+ * (see `vdso.h`) instead of making a system call.
+ */
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * Reads the `time` CSR directly and converts it with the time base the kernel
+ * publishes, so no trap is taken. Same clock as `SYS_CLOCK_GETTIME`.
+ *
+ * @return Nanoseconds since the machine was reset.
+ */
+uint64_t clock_gettime(void);
+
+/**
+ * @brief Returns the process ID of the calling process.
+ */
+int32_t getpid(void);
+
+/**
+ * @brief Returns the process ID of the process that spawned the caller, or 0.
+ */
+int32_t getppid(void);
+
+/**
+ * @brief Returns the argument the calling process was spawned with, or 0.
+ */
+int32_t getarg(void);
+
+/**
+ * @brief Takes a consistent snapshot of the system-wide counters.
+ *
+ * @param counters Receives the counters.
+ */
+void vdso_counters(struct vdso_counters *counters);
@@ -3,36 +3,82 @@
 #include "sys.h"
 #include "types.h"
 
-int32_t syscall(int32_t sysno, int32_t arg0, int32_t arg1, int32_t arg2) {
+int32_t syscall(int32_t sysno, int32_t arg0, int32_t arg1, int32_t arg2,
+                int32_t arg3, int32_t arg4, int32_t arg5) {
     register int32_t a0 __asm__("a0") = arg0;
     register int32_t a1 __asm__("a1") = arg1;
     register int32_t a2 __asm__("a2") = arg2;
-    register int32_t a3 __asm__("a3") = sysno;
+    register int32_t a3 __asm__("a3") = arg3;
+    register int32_t a4 __asm__("a4") = arg4;
+    register int32_t a5 __asm__("a5") = arg5;
+    register int32_t a7 __asm__("a7") = sysno;
 
     __asm__ __volatile__("ecall"
                          : "=r"(a0)
-                         : "r"(a0), "r"(a1), "r"(a2), "r"(a3)
+                         : "r"(a0), "r"(a1), "r"(a2), "r"(a3), "r"(a4), "r"(a5), "r"(a7)
                          : "memory");
 
     return a0;
 }
 
+SYSCALLS(DEFINE_SYSCALL_STUB)
+
 void putchar(char ch) {
-    syscall(SYS_PUTCHAR, ch, 0, 0);
+    syscall_putchar(ch);
 }
 
 int32_t getchar(void) {
-    return syscall(SYS_GETCHAR, 0, 0, 0);
+    return syscall_getchar(0);
+}
+
+int32_t getchar_timeout(int32_t timeout_ms) {
+    return syscall_getchar(timeout_ms);
 }
 
 int32_t readfile(const char *filename, char *buf, int32_t len) {
-    return syscall(SYS_READFILE, (int32_t)filename, (int32_t)buf, len);
+    return syscall_readfile((int32_t)filename, (int32_t)buf, len);
 }
 
 int32_t writefile(const char *filename, const char *buf, int32_t len) {
-    return syscall(SYS_WRITEFILE, (int32_t)filename, (int32_t)buf, len);
+    return syscall_writefile((int32_t)filename, (int32_t)buf, len);
 }
 
 void shutdown(void) {
-    syscall(SYS_SHUTDOWN, 0, 0, 0);
+    syscall_shutdown();
+}
+
+int32_t pagestat(struct pagestat *stats, int32_t n) {
+    return syscall_pagestat((int32_t)stats, n);
+}
+
+int32_t nanosleep(uint64_t ns, int32_t flags) {
+    return syscall_nanosleep((uint32_t)ns, (uint32_t)(ns >> 32), flags);
+}
+
+void sleep(uint32_t ms) {
+    nanosleep((uint64_t)ms * 1000000, 0);
+}
+
+int32_t procstat(struct procstat *stats, int32_t n) {
+    return syscall_procstat((int32_t)stats, n);
+}
+
+int32_t spawn(const char *name, int32_t arg) {
+    return syscall_spawn((int32_t)name, arg);
+}
+
+int32_t wait(int32_t pid) {
+    return syscall_wait(pid);
+}
+
+void sched_yield(void) {
+    syscall_sched_yield();
+}
+
+int32_t diskread(uint32_t dev, uint32_t sector, void *buf, uint32_t count) {
+    return syscall_diskread(dev, sector, (int32_t)buf, count);
+}
+
+int32_t iostat(struct iostat *stats, int32_t n) {
+    return syscall_iostat((int32_t)stats, n);
 }
@@ -2,10 +2,9 @@
 
 #include "ecall.h"
 #include "lib.h"
-#include "sys.h"
 
 __attribute__((noreturn)) void exit(void) {
-    syscall(SYS_EXIT, 0, 0, 0);
+    syscall_exit();
     while (true) {
         __asm__ __volatile__("wfi");
     };  // Just in case!
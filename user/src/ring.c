@@ -0,0 +1,35 @@
+#include "ring.h"
+
+#include "ecall.h"
+#include "ioring.h"
+#include "lib.h"
+#include "types.h"
+
+struct ioring *ring_setup(void) {
+    int32_t ret = syscall_ring_setup();
+    return ret < 0 ? NULL : (struct ioring *)ret;
+}
+
+bool ring_queue(struct ioring *r, const struct ring_sqe *sqe) {
+    if (r->sq_tail - r->sq_head == RING_ENTRIES)
+        return false;
+
+    r->sqes[r->sq_tail & RING_MASK] = *sqe;
+    __sync_synchronize();  // Publish the entry before the new tail.
+    r->sq_tail++;
+    return true;
+}
+
+int32_t ring_submit(struct ioring *r, uint32_t min_complete) {
+    return syscall_ring_enter(r->sq_tail - r->sq_head, min_complete);
+}
+
+bool ring_peek(struct ioring *r, struct ring_cqe *cqe) {
+    if (r->cq_head == r->cq_tail)
+        return false;
+
+    __sync_synchronize();  // Read the entry only after seeing the tail.
+    *cqe = r->cqes[r->cq_head & RING_MASK];
+    r->cq_head++;
+    return true;
+}
@@ -3,8 +3,10 @@
 #include "ecall.h"
 #include "exit.h"
 #include "lib.h"
+#include "ring.h"
 #include "str.h"
 #include "utils.h"
+#include "vsyscall.h"
 
 void main(void) {
     while (true) {
@@ -30,12 +32,152 @@ void main(void) {
             printf("Hello world from shell!\n");
         else if (strcmp(cmdline, "readfile") == 0) {
             char buf[128];
-            int32_t len = readfile("hello.txt", buf, sizeof(buf));
-            buf[len] = '\0';
-            printf("%s\n", buf);
+            int32_t len = readfile("hello.txt", buf, sizeof(buf) - 1);
+            if (len < 0) {
+                FAILED("readfile failed: %d", len);
+            } else {
+                buf[len] = '\0';
+                printf("%s\n", buf);
+            }
         } else if (strcmp(cmdline, "writefile") == 0)
             writefile("hello.txt", "Hello from shell!\n", 19);
-        else if (strcmp(cmdline, "shutdown") == 0)
+        else if (strcmp(cmdline, "pagestat") == 0) {
+            struct pagestat stats[8];
+            int32_t harts = pagestat(stats, sizeof(stats) / sizeof(stats[0]));
+            printf("hart  allocs  hit%%  refills  drains  cached\n");
+            for (int32_t hart = 0; hart < harts; hart++) {
+                if (!stats[hart].allocs && !stats[hart].frees)
+                    continue;
+                // A hart may only have freed pages, which leaves no hit rate.
+                printf("%d     %d     ", hart, stats[hart].allocs);
+                if (stats[hart].allocs)
+                    printf("%d%%", stats[hart].hits * 100 / stats[hart].allocs);
+                else
+                    printf("-");
+                printf("   %d       %d       %d\n", stats[hart].refills, stats[hart].drains,
+                       stats[hart].cached);
+            }
+        } else if (strcmp(cmdline, "top") == 0) {
+            // Sample the process table twice, one second apart, and show each
+            // process's share of that second.
+            struct procstat before[8], after[8];
+            int32_t n_before = procstat(before, sizeof(before) / sizeof(before[0]));
+            uint64_t start = clock_gettime();
+            sleep(1000);
+            int32_t n_after = procstat(after, sizeof(after) / sizeof(after[0]));
+            uint32_t elapsed_us = (uint32_t)((clock_gettime() - start) / 1000);
+
+            printf("pid  S  cpu%%  user ms  sys ms  vcsw  ivcsw\n");
+            for (int32_t i = 0; i < n_after; i++) {
+                struct procstat *cur = &after[i];
+                uint64_t prev_time = 0;
+                for (int32_t j = 0; j < n_before; j++) {
+                    if (before[j].pid == cur->pid)
+                        prev_time = before[j].utime + before[j].stime;
+                }
+                uint32_t busy_us = (uint32_t)((cur->utime + cur->stime - prev_time) / 1000);
+
+                printf("%d%s  %c  %d     %d      %d     %d     %d\n", cur->pid, cur->kernel ? "k" : " ",
+                       "?RZS"[cur->state], busy_us * 100 / elapsed_us, (int32_t)(cur->utime / 1000000),
+                       (int32_t)(cur->stime / 1000000), cur->nvcsw, cur->nivcsw);
+            }
+        } else if (strcmp(cmdline, "iostat") == 0) {
+            // Counters since boot, then the latency histogram of every
+            // operation type a device has seen.
+            static struct iostat stats[16];
+            int32_t n = iostat(stats, sizeof(stats) / sizeof(stats[0]));
+            uint64_t uptime = clock_gettime();
+            static const char *const op_names[IOSTAT_OPS] = {"read", "write", "flush"};
+
+            printf("device    reads  rsect  writes  wsect  flushes  errors  inflight  max  busy ms  util%%\n");
+            for (int32_t i = 0; i < n; i++) {
+                struct iostat *s = &stats[i];
+                printf("%s  %d  %d  %d  %d  %d  %d  %d  %d  %d  %d%%\n", s->name, s->ops[IOSTAT_READ],
+                       s->sectors[IOSTAT_READ], s->ops[IOSTAT_WRITE], s->sectors[IOSTAT_WRITE], s->ops[IOSTAT_FLUSH],
+                       s->errors, s->inflight, s->inflight_max, (int32_t)(s->busy / 1000000),
+                       (int32_t)(s->busy * 100 / uptime));
+            }
+            for (int32_t i = 0; i < n; i++) {
+                for (int32_t op = 0; op < IOSTAT_OPS; op++) {
+                    struct iostat *s = &stats[i];
+                    if (!s->ops[op])
+                        continue;
+                    printf("%s %s latency, avg %d us:\n", s->name, op_names[op],
+                           (int32_t)(s->latency[op] / s->ops[op] / 1000));
+                    for (int32_t b = 0; b < IOSTAT_BUCKETS; b++) {
+                        if (!s->histogram[op][b])
+                            continue;
+                        if (b == 0)
+                            printf("  <1 us: %d\n", s->histogram[op][b]);
+                        else if (b == IOSTAT_BUCKETS - 1)
+                            printf("  >=%d us: %d\n", 1 << (b - 1), s->histogram[op][b]);
+                        else
+                            printf("  %d-%d us: %d\n", 1 << (b - 1), (1 << b) - 1, s->histogram[op][b]);
+                    }
+                }
+            }
+        } else if (strcmp(cmdline, "sleep") == 0) {
+            uint64_t start = clock_gettime();
+            sleep(1000);
+            printf("slept for %d us\n", (int32_t)((uint32_t)(clock_gettime() - start) / 1000));
+        } else if (strcmp(cmdline, "nullbench") == 0) {
+            // Time a batch of empty system calls with the cycle counter; the
+            // loop overhead is a handful of cycles and is not subtracted.
+            const uint32_t calls = 10000;
+            uint32_t start, end;
+            syscall_null();
+            __asm__ __volatile__("rdcycle %0" : "=r"(start));
+            for (uint32_t i = 0; i < calls; i++)
+                syscall_null();
+            __asm__ __volatile__("rdcycle %0" : "=r"(end));
+            printf("null syscall: %d cycles/call (%d calls)\n", (end - start) / calls, calls);
+        } else if (strcmp(cmdline, "ring") == 0) {
+            // Echo a message, read a file and wait 100 ms, all in one system call.
+            static struct ioring *ring;
+            if (!ring)
+                ring = ring_setup();
+            if (!ring) {
+                FAILED("ring_setup failed");
+                continue;
+            }
+
+            static const char msg[] = "hello from the submission ring\n";
+            char buf[128];
+            uint64_t timeout_ns = 100 * 1000000ull;
+            struct ring_sqe sqes[] = {
+                {.opcode = RING_OP_WRITE, .user_data = 1, .addr = (uint32_t)msg, .len = sizeof(msg) - 1},
+                {.opcode = RING_OP_READFILE, .user_data = 2, .addr = (uint32_t)buf, .len = sizeof(buf) - 1,
+                 .name = (uint32_t)"hello.txt"},
+                {.opcode = RING_OP_TIMEOUT, .user_data = 3, .addr = (uint32_t)&timeout_ns},
+            };
+            uint32_t n = sizeof(sqes) / sizeof(sqes[0]);
+            for (uint32_t i = 0; i < n; i++)
+                ring_queue(ring, &sqes[i]);
+            ring_submit(ring, n);
+
+            struct ring_cqe cqe;
+            while (ring_peek(ring, &cqe)) {
+                printf("op %d: %d\n", cqe.user_data, cqe.res);
+                if (cqe.user_data == 2 && cqe.res >= 0) {
+                    buf[cqe.res] = '\0';
+                    printf("%s\n", buf);
+                }
+            }
+        } else if (strcmp(cmdline, "vdso") == 0) {
+            // Everything below is read without a single system call.
+            struct vdso_counters counters;
+            vdso_counters(&counters);
+            printf("pid %d, uptime %d ms\n", getpid(), (int32_t)(clock_gettime() / 1000000));
+            printf("context switches %d, syscalls %d, interrupts %d\n", (int32_t)counters.context_switches,
+                   (int32_t)counters.syscalls, (int32_t)counters.interrupts);
+        } else if (strcmp(cmdline, "bench") == 0) {
+            int32_t pid = spawn("bench", 0);
+            if (pid < 0) {
+                FAILED("spawn failed: %d", pid);
+            } else {
+                wait(pid);
+            }
+        } else if (strcmp(cmdline, "shutdown") == 0)
             shutdown();
         else if (strcmp(cmdline, "exit") == 0)
             exit();
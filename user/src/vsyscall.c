@@ -0,0 +1,50 @@
+#include "vsyscall.h"
+
+#include "types.h"
+#include "vdso.h"
+
+#define NSEC_PER_SEC 1000000000ull
+
+/**
+ * @brief The kernel data pages, mapped read-only by the kernel.
+ */
+#define vdso ((const struct vdso_data *)VDSO_VADDR)
+#define vdso_proc ((const struct vdso_proc *)VDSO_PROC_VADDR)
+
+uint64_t clock_gettime(void) {
+    uint32_t hi, lo, tmp;
+    __asm__ __volatile__(
+        "1:\n"
+        "rdtimeh %0\n"
+        "rdtime %1\n"
+        "rdtimeh %2\n"
+        "bne %0, %2, 1b\n"  // The upper half changed in between: read again.
+        : "=&r"(hi), "=&r"(lo), "=&r"(tmp));
+
+    // Split into whole seconds and a remainder so that the products cannot overflow.
+    uint64_t ticks = ((uint64_t)hi << 32) | lo;
+    uint32_t freq = vdso->timebase_freq;
+    return ticks / freq * NSEC_PER_SEC + ticks % freq * NSEC_PER_SEC / freq;
+}
+
+int32_t getpid(void) {
+    return vdso_proc->pid;
+}
+
+int32_t getppid(void) {
+    return vdso_proc->ppid;
+}
+
+int32_t getarg(void) {
+    return vdso_proc->arg;
+}
+
+void vdso_counters(struct vdso_counters *counters) {
+    uint32_t seq;
+    do {
+        seq = vdso->seq;
+        __sync_synchronize();  // Read the counters only after the sequence count...
+        *counters = vdso->counters;
+        __sync_synchronize();  // ...and check it again only after the counters.
+    } while ((seq & 1) || seq != vdso->seq);
+}